@@ -11,11 +11,15 @@ QMAKE_LFLAGS += -Wl,--stack,64000000 -Wall
 
 HEADERS += \
     include/bitset.h \
+    include/blocks.h \
     include/bufferusage.h \
     include/cluster.h \
+    include/cooling.h \
     include/core.h \
     include/coremapping.h \
     include/datalayout.h \
+    include/dp.h \
+    include/evo.h \
     include/json/json.h \
     include/json/json_autolink.h \
     include/json/json_batchallocator.h \
@@ -29,6 +33,7 @@ HEADERS += \
     include/json/json_valueiterator.inl \
     include/json/json_writer.h \
     include/layer.h \
+    include/layerdb.h \
     include/layerengine.h \
     include/ltreenode.h \
     include/network.h \
@@ -36,21 +41,30 @@ HEADERS += \
     include/noc.h \
     include/partition.h \
     include/placement.h \
+    include/resultwriter.h \
     include/sa.h \
+    include/schcache.h \
     include/schnode.h \
+    include/simulator.h \
+    include/transtable.h \
     include/util.h
 
 SOURCES += \
     src/bitset.cpp \
+    src/blocks.cpp \
     src/bufferusage.cpp \
     src/cluster.cpp \
+    src/cooling.cpp \
     src/core.cpp \
     src/coremapping.cpp \
     src/datalayout.cpp \
+    src/dp.cpp \
+    src/evo.cpp \
     src/json/json_reader.cpp \
     src/json/json_value.cpp \
     src/json/json_writer.cpp \
     src/layer.cpp \
+    src/layerdb.cpp \
     src/layerengine.cpp \
     src/ltreenode.cpp \
     src/main.cpp \
@@ -70,8 +84,12 @@ SOURCES += \
     src/noc.cpp \
     src/partition.cpp \
     src/placement.cpp \
+    src/resultwriter.cpp \
     src/sa.cpp \
+    src/schcache.cpp \
     src/schnode.cpp \
+    src/simulator.cpp \
+    src/transtable.cpp \
     src/util.cpp
 
 INCLUDEPATH += include/
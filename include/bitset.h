@@ -26,7 +26,10 @@
 #define FOR_BITSET(var, set) for(Bitset::bitlen_t var = set.first(); var != set.size(); var = set.next(var))
 
 // Maximal number of bits in the bitset. (must be representable by bitlen_t)
+// Can be set when building, e.g. "make MAX_BITS=4096" (after "make clean") for full LLMs.
+#ifndef MAX_BITS_IN_BS
 #define MAX_BITS_IN_BS 640
+#endif
 
 // Wrapper for std::bitset
 class Bitset: private std::bitset<MAX_BITS_IN_BS>{
@@ -40,6 +43,9 @@ public:
 	static_assert(std::numeric_limits<bitlen_t>::max() >= MAX_BITS_IN_BS,
 		"bitlen_t must be able to hold MAX_BITS_IN_BS, change it to a larger type.");
 
+	// Maximal number of bits (i.e. layers in a network).
+	static constexpr bitlen_t MAX_BITS = MAX_BITS_IN_BS;
+
 	Bitset()=default;
 	explicit Bitset(bitlen_t bit);
 	explicit Bitset(std::initializer_list<bitlen_t> bits);
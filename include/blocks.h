@@ -0,0 +1,73 @@
+/* This file contains
+ *	BlockStitcher: Schedules a network of repeated blocks from the RA Tree of a single block.
+ *
+ *  The full network (e.g. BERT with 24 blocks) has layers [start, start + period*num)
+ *  as "num" repeated blocks (see Network::find_blocks), and the block network
+ *  is the same network with only one block (e.g. BERT_block).
+ *  The RA Tree searched on the block network is replicated for each block:
+ *  each child of the root is copied once for each block, with layers before
+ *  the blocks only in the first copy, and layers after the blocks only in the last copy.
+ *  Since children of the root communicate through DRAM, each block sees the
+ *  same boundary as the single block.
+ *
+ *  Then the block boundaries are refined: the last segment of each block and
+ *  the first segment of the next block are merged into one cut (of the type of
+ *  the next segment if it is a cut, otherwise S), if their batch sizes match,
+ *  and the merged tree is kept if it is better.
+ */
+
+#ifndef BLOCKS_H
+#define BLOCKS_H
+
+#include <cstddef>
+#include <iostream>
+
+#include "ltreenode.h"
+#include "util.h"
+
+class Cluster;
+class Network;
+struct WholeSch;
+//#include "cluster.h"
+//#include "network.h"
+//#include "sa.h"
+
+
+class BlockStitcher{
+	const Network& full;
+	const Network& block;
+	lid_t start, period, num;
+
+	// Id in "full" of layer "id" of "block" in the k-th copy (0 <= k < num),
+	// or full.len() if the layer is not in this copy.
+	lid_t map_id(lid_t id, lid_t k) const;
+
+	// Whether the subtree of "node" has any layer in the k-th copy.
+	bool has_layers(LTreeNode* node, lid_t k) const;
+
+	// Writes the k-th copy of "node" in the format of LTreeNode::save().
+	void write_node(std::ostream& os, LTreeNode* node, lid_t k) const;
+	// Writes the line of a cut in the format of LTreeNode::save().
+	static void write_cut(std::ostream& os, LTreeNode::NodeType t, len_t batch, std::size_t num_children);
+
+	// Builds the RA Tree of "full" from "block_tree", with block boundaries merged if "merge".
+	// Returns nullptr if the tree does not fit "full", or if no boundary can be merged.
+	LTreeNode* stitch_tree(LTreeNode* block_tree, bool merge) const;
+
+public:
+	// Throws std::invalid_argument if "block" is not "full" with only one block.
+	BlockStitcher(const Network& _full, const Network& _block);
+	BlockStitcher(const BlockStitcher&) = delete;
+
+	lid_t get_num() const;
+	lid_t get_period() const;
+
+	/*
+	 * Stitches the RA Tree of "block_sch" (on "block") to "full", and refines block boundaries.
+	 * The global "network" must be "full" (with utime set).
+	 * Returns an empty WholeSch if no valid scheme is found.
+	 */
+	WholeSch stitch(const WholeSch& block_sch, const Cluster& c) const;
+};
+
+#endif // BLOCKS_H
@@ -0,0 +1,80 @@
+/* This file contains
+ *	CoolingSchedule:  [base class] Temperature schedule of SA.
+ *  FixedCooling:     The original schedule, T = 0.07 * (1-x)/(1+8x).
+ *  AdaptiveCooling:  Schedule calibrated by cost deltas and acceptance ratio.
+ *
+ *  x = round / nrounds is the progress of SA, in [0, 1).
+ *  SA accepts a worse scheme with probability exp(-delta/T),
+ *  where delta = (new_cost - cur_cost) / cur_cost.
+ */
+
+#ifndef COOLING_H
+#define COOLING_H
+
+#include <string>
+
+#include "util.h"
+
+
+class CoolingSchedule{
+public:
+	virtual ~CoolingSchedule() = default;
+
+	// Temperature at progress x.
+	virtual double temperature(double x) const = 0;
+
+	// Called after each valid candidate.
+	// delta: relative cost increase. new_min: whether it is the best scheme so far.
+	virtual void update(double x, double delta, bool accepted, bool new_min);
+
+	// Creates a schedule by name ("fixed" or "adaptive"), for a SA of "nrounds" rounds.
+	// Throws std::invalid_argument for unknown names.
+	static CoolingSchedule* newSchedule(const std::string& name, int nrounds);
+};
+
+class FixedCooling : public CoolingSchedule{
+public:
+	virtual double temperature(double x) const override;
+};
+
+/*
+ * AdaptiveCooling:
+ *  - Target acceptance ratio of worse schemes is p0 * (1-x)/(1+8x).
+ *  - T is chosen so that the average delta is accepted with the target ratio,
+ *    T = -scale * avg_delta / ln(target), where avg_delta is calibrated
+ *    from the first calib_num worse schemes (FixedCooling is used before).
+ *  - "scale" is adjusted by the difference of actual and target ratio.
+ *  - When the best scheme is not improved for "stall" candidates, reheats by doubling "scale".
+ */
+class AdaptiveCooling : public CoolingSchedule{
+	// Initial target acceptance ratio.
+	static constexpr double p0 = 0.3;
+	// Decay of the averages, and gain of the acceptance feedback.
+	static constexpr double decay = 0.02;
+	static constexpr double gain = 0.05;
+	// Maximal reheat scale.
+	static constexpr double max_scale = 8;
+
+	const int calib_num;
+	const int stall;
+
+	FixedCooling fixed;
+
+	// Number of worse schemes seen.
+	int num_worse;
+	// Average delta and acceptance ratio of worse schemes.
+	double avg_delta, avg_accept;
+	double scale;
+	// Number of candidates since last new minimal.
+	int num_stall;
+
+	static double target(double x);
+
+public:
+	AdaptiveCooling(int nrounds);
+
+	virtual double temperature(double x) const override;
+	virtual void update(double x, double delta, bool accepted, bool new_min) override;
+};
+
+#endif // COOLING_H
@@ -10,6 +10,7 @@
 #define CORE_H
 
 #include <cstdint>
+#include <iostream>
 
 #include "util.h"
 
@@ -40,6 +41,10 @@ public:
 
 	// Global buffer (largest buffer of each core) information.
 	virtual const Buffer& ubuf() const = 0;
+
+	// Prints all hardware parameters (used as a fingerprint of the core).
+	virtual void print_config(std::ostream& os) const;
+
 	virtual ~Core() = default;
 };
 
@@ -73,6 +78,7 @@ public:
 			  const Bus& _noc, const Buffers& _bufs);
 
 	virtual const Core::Buffer& ubuf() const override;
+	virtual void print_config(std::ostream& os) const override;
 };
 
 class EyerissCore : public Core {
@@ -106,6 +112,7 @@ public:
 				const Buses& _buses, const Buffers& _bufs);
 
 	virtual const Core::Buffer& ubuf() const override;
+	virtual void print_config(std::ostream& os) const override;
 };
 
 #endif // CORE_H
@@ -2,6 +2,7 @@
  *	CoreMapper:    base class for core mappings (loop-tiling, cost eval, BSD, ...)
  *  EyerissMapper: mapper for the core with Eyeriss architecture.
  *  PolarMapper:   mapper for the core in our test chip.
+ *  RooflineMapper: O(1) estimate of the best mapping, for screening partitions.
  *
  *  One can add their own core mappings as classes here (e.g. for their own cores).
  */
@@ -15,7 +16,9 @@
 #include "layer.h"
 #include "util.h"
 
+class LayerDB;
 class PartSch;
+//#include "layerdb.h"
 //#include "partition.h"
 
 
@@ -24,6 +27,10 @@ public:
 	typedef ConvLayer::Workload ConvParent;
 	struct ConvWl: public ConvParent{
 		len_t B, nGroup;
+		// Fraction of MACs not skipped (zero weights), only speeds up the MAC array.
+		double density;
+		// Bitwidths of the ifmap and weights, for the L1/L2 buffers in the core (see elem_buffer).
+		bwidth_t ifm_bits, wgt_bits;
 
 		ConvWl(const ConvParent& parent, len_t _B);
 
@@ -31,6 +38,12 @@ public:
 		vol_t ifm_size() const;
 		vol_t ofm_size() const;
 		void calc_op();
+
+		// Whether each ofmap channel reads only one ifmap channel (C = 1 in each
+		// of multiple groups, e.g. depthwise conv). Channels of all groups are independent.
+		bool is_depthwise() const;
+		// Time of the MAC array, from "comp_time" of dense weights.
+		cycle_t mac_time(cycle_t comp_time) const;
 	};
 
 	struct MapCost{
@@ -51,14 +64,35 @@ public:
 
 		CoreMapping& operator*=(len_t factor);
 		CoreMapping& operator+=(const CoreMapping& other);
+		// Scales MAC energy by "factor" (e.g. for MACs of other bitwidths or skipped MACs).
+		CoreMapping& scale_mac(double factor);
 	};
 
 	// Base core
 	const Core& base_core;
 
+	// "buf" holding elements of "bits" bits: Size and access costs are in elements
+	// (Size and costs of the config are for 8-bit elements). Bandwidths are unchanged.
+	static Core::Buffer elem_buffer(const Core::Buffer& buf, bwidth_t bits);
+
+private:
+	// Records results of genMapping, nullptr if not used.
+	LayerDB* db;
+
+	// Mapping of an ofmap tile (of B batches) of "layer" in a core,
+	// with MAC energy scaled by "mac_scale" (see genLayerMap).
+	CoreMapping genTileMap(const Layer& layer, const fmap_shape& tile, len_t B, bool wgtB, double mac_scale, bwidth_t ifm_bits, bwidth_t wgt_bits);
+
+public:
 	CoreMapper(const Core& c);
 
-	CoreMapping genLayerMap(const Layer& layer, const PartSch& part, len_t batch_size, bool wgtB);
+	void set_db(LayerDB* _db);
+
+	// MAC energy of the layer (the base layer, if fused) is scaled by "mac_scale"
+	// (bitwidths and sparsity), post layers of a fused layer by the bitwidth of their ifmaps.
+	// "ifm_bits" and "wgt_bits" are the bitwidths of the ifmap and weights of the layer.
+	CoreMapping genLayerMap(const Layer& layer, const PartSch& part, len_t batch_size, bool wgtB,
+							double mac_scale = 1, bwidth_t ifm_bits = 8, bwidth_t wgt_bits = 8);
 
 	const Core& core() const;
 	vol_t get_ubuf_size() const;
@@ -132,11 +166,20 @@ class PolarMapper: public CoreMapper{
 	public:
 		Instance(const PolarCore& _core);
 
-		CoreMapping genMapping(const ConvWl& wl);
+		// Returns the best mapping found by tiling, or "init" if none is cheaper
+		// (partitions that can't beat "init" are skipped).
+		CoreMapping genMapping(const ConvWl& wl, const CoreMapping& init = CoreMapping());
+		// Closed-form mapping of a depthwise workload (see genDepthwise in coremapping.cpp),
+		// used by the mapper as "init" of genMapping.
+		// Returns an invalid mapping if the L1 buffers are too small.
+		CoreMapping genDepthwise(const ConvWl& wl);
 	};
 
 	const PolarCore& core;
 
+	// Mapping of "wl" on core "c" (with buffers in elements of the bitwidths of "wl").
+	static CoreMapping genMapping(const PolarCore& c, const ConvWl& wl);
+
 public:
 	PolarMapper(const PolarCore& _core);
 
@@ -178,14 +221,40 @@ class EyerissMapper : public CoreMapper{
 		Instance(const EyerissCore& _core);
 
 		CoreMapping genMapping(const ConvWl& wl);
+		// Closed-form mapping of a depthwise workload (see genDepthwise in coremapping.cpp),
+		// kept by the mapper only if it is cheaper than genMapping.
+		// Returns an invalid mapping if the L1 buffers are too small.
+		CoreMapping genDepthwise(const ConvWl& wl);
 	};
 
 	const EyerissCore& core;
 
+	// Mapping of "wl" on core "c" (with buffers in elements of the bitwidths of "wl").
+	static CoreMapping genMapping(const EyerissCore& c, const ConvWl& wl);
+
 public:
 	EyerissMapper(const EyerissCore& _core);
 
 	virtual CoreMapping genMapping(const ConvWl& wl) override;
 };
 
+/*
+ * Closed-form (roofline) estimate of the best mapping, without loop tiling.
+ * Time is the MAC time (C/K padded to the vector/lane sizes of PolarCore,
+ * or R*S and channels for depthwise workloads, as in PolarMapper),
+ * or the time to read ifmap and filter from ubuf, whichever is larger.
+ * Energy is the MAC energy plus one ubuf access of each ifmap/filter/ofmap datum (full reuse).
+ * Only used to rank partitions (see StdLayerEngine::set_screen), not as a real mapping.
+ */
+class RooflineMapper : public CoreMapper{
+	energy_t mac_cost;
+	// MAC array size on C and K.
+	len_t vec_c, vec_k;
+
+public:
+	RooflineMapper(const Core& c);
+
+	virtual CoreMapping genMapping(const ConvWl& wl) override;
+};
+
 #endif // COREMAPPING_H
@@ -94,7 +94,12 @@ protected:
 	 */
 	len_t multFactor;
 
-	// Only updates *totVolume* and *maxVolume* by "range.size()"
+	// Bits of each datum. All volumes are in 8-bit units (see dataVol()).
+	bwidth_t bitwidth;
+	// Sparsity of data (only for weights), volumes are compressed.
+	Sparsity sparsity;
+
+	// Only updates *totVolume* and *maxVolume* by the volume of "range"
 	void update(const fmap_range& range);
 
 public:
@@ -105,6 +110,14 @@ public:
 	// Returns maxVolume
 	vol_t maxRange() const;
 
+	// Sets the bitwidth of data (8 by default), before any update().
+	void setBitwidth(bwidth_t width);
+	bwidth_t getBitwidth() const;
+	// Sets the sparsity of data (dense by default), before any update().
+	void setSparsity(const Sparsity& sp);
+	// Volume of "num" data, in 8-bit units.
+	vol_t dataVol(vol_t num) const;
+
 	// Mult all data size by *num*
 	void sizeMult(len_t num);
 	// Clears all data size
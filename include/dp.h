@@ -0,0 +1,105 @@
+/* This file contains
+ *	DPEngine: Dynamic programming over segments of the layer order.
+ *
+ *  DPEngine searches RA Trees whose top T cut is divided into segments
+ *  of consecutive layers (in network order). All segments have the same
+ *  batch size (tot_batch / 2^k). Each segment is either one layer,
+ *  or an S/T cut of its layers with a smaller (or equal) batch size.
+ *
+ *  Since segments communicate only through DRAM, the cost of a segment
+ *  does not depend on the other segments, and the cost of the tree is the
+ *  sum of its segments. Each segment is scheduled once (in parallel),
+ *  and a Pareto front of (energy, time) is kept for each prefix of layers
+ *  (for each segment batch size), thus the result is optimal
+ *  for any monotone cost function.
+ *  For chain networks (Network::is_chain()) these are all LP/LS/LSP trees.
+ */
+
+#ifndef DP_H
+#define DP_H
+
+#include <cstddef>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "cluster.h"
+#include "ltreenode.h"
+#include "schnode.h"
+#include "util.h"
+
+struct WholeSch;
+//#include "sa.h"
+
+
+class DPEngine{
+	// One segment: layers in [from, to], with batch size "top",
+	// and type and batch size of its layers.
+	// A single layer is an L node with batch size "top".
+	struct Segment{
+		lid_t from, to;
+		LTreeNode::NodeType type;
+		len_t top, batch;
+	};
+	typedef std::tuple<lid_t, lid_t, LTreeNode::NodeType, len_t, len_t> seg_key;
+
+	// One point on the Pareto front of a prefix.
+	struct Label{
+		SchNode::SchCost cost;
+		// The last segment, and the label of the prefix before it.
+		Segment seg;
+		std::size_t prev;
+	};
+
+	const Cluster cluster;
+	const len_t tot_batch;
+	const lid_t num_layer;
+	const unsigned num_threads;
+	// Maximal number of layers in a segment.
+	const lid_t max_len;
+
+	// Memoized costs of scheduled segments (invalid ones are also kept).
+	std::map<seg_key, SchNode::SchCost> seg_costs;
+
+	// Schemes with all layers as single-layer segments (one for each segment batch size),
+	// whose LNodes are reused when scheduling other segments.
+	std::map<len_t, std::pair<LTreeNode*, SchNode*>> singles;
+
+	static seg_key key(const Segment& seg);
+
+	// Single-layer segments of layers in [from, to).
+	static void add_singles(std::vector<Segment>& segs, lid_t from, lid_t to, len_t top);
+
+	// Builds the RA Tree consisting of "segs", and calls init_root().
+	LTreeNode* build_tree(const std::vector<Segment>& segs) const;
+
+	// Schedules "seg", with all other layers as single-layer segments.
+	SchNode::SchCost eval(const Segment& seg) const;
+
+	// Schedules all segments in "segs" which are not in seg_costs.
+	void eval_all(const std::vector<Segment>& segs);
+
+	// All segments ending at layer "to", with S cuts if has_S and T cuts if has_T.
+	std::vector<Segment> segments_to(lid_t to, len_t top, bool has_S, bool has_T) const;
+
+	// DP over segments with batch size "top".
+	// Returns the segments of the optimal tree (empty if not found), and its cost in "cost".
+	std::vector<Segment> optimal_segments(len_t top, bool has_S, bool has_T, SchNode::SchCost& cost);
+
+public:
+	// Segments have at most _max_len layers (0 for no limit), and are scheduled by _num_threads threads.
+	DPEngine(const Cluster& c, len_t _tot_batch, unsigned _num_threads = 1, lid_t _max_len = 0);
+	DPEngine(const DPEngine&) = delete;
+	~DPEngine();
+
+	/*
+	 * Searches the optimal RA Tree, whose cuts are S cuts if has_S,
+	 * and T cuts if has_T (at least one of them).
+	 * Results are returned in w_sch (nullptr if not found).
+	 * Segment costs are kept for later searches.
+	 */
+	void search(WholeSch& w_sch, bool has_S, bool has_T);
+};
+
+#endif // DP_H
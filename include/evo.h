@@ -0,0 +1,89 @@
+/* This file contains
+ *	EvoEngine: Evolutionary search of RA Trees.
+ *
+ *  EvoEngine keeps a population of RA Trees. Each generation, children are
+ *  made from parents picked by tournament selection: a subtree crossover
+ *  (a subtree of one parent is replaced by the subtree of another parent
+ *  with the same layers, type and batch, e.g. a whole DRAM segment),
+ *  followed by one mutation (an OP of SAEngine::sa_change).
+ *  Children are scheduled in parallel, and the best distinct RA Trees
+ *  among parents and children form the next population.
+ */
+
+#ifndef EVO_H
+#define EVO_H
+
+#include <cstdint>		// std::uint32_t
+#include <random>		// std::mt19937
+#include <vector>		// std::vector
+
+#include "ltreenode.h"
+#include "sa.h"
+#include "util.h"
+
+class Cluster;
+class SchNode;
+//#include "cluster.h"
+//#include "schnode.h"
+
+
+class EvoEngine{
+public:
+	// Number of generations, 0 to disable.
+	static int num_gens;
+	// Number of RA Trees in the population (also #children in each generation).
+	static constexpr std::size_t pop_size = 16;
+
+private:
+	// Probability of crossover for each child.
+	static constexpr double cross_prob = 0.5;
+	// Number of candidates in tournament selection.
+	static constexpr int tour_size = 2;
+
+	// A child to be scheduled, "base" is the scheme of its first parent.
+	struct Child{
+		LTreeNode* tree;
+		const SchNode* base;
+		SchNode* sch;
+	};
+
+	const unsigned num_threads;
+
+	// Random generator
+	std::mt19937 generator;
+	// Provides the mutation OPs (sa_change), with its own random generator.
+	SAEngine mutator;
+
+	// Uniform int between [0, to)
+	int randInt(int to);
+	// Bernoulli variable with probability "prob".
+	bool withProb(double prob);
+
+	// Tournament selection, pop is sorted by cost.
+	std::size_t select(const std::vector<WholeSch>& pop);
+
+	// Adds all nodes in the subtree of "node" (except "node") to "nodes".
+	static void collect(LTreeNode* node, LTreeNode::node_vec& nodes);
+	// Whether two subtrees have the same structure.
+	static bool same_tree(const LTreeNode* a, const LTreeNode* b);
+	// Replaces a random subtree of "tree" by a different subtree of "other" with the same
+	// layers, type and batch. Returns false if there is no such subtree.
+	bool crossover(LTreeNode* tree, LTreeNode* other);
+
+	// Schedules all children in parallel. Invalid schemes are set to nullptr.
+	void evaluate(std::vector<Child>& children, const Cluster& c);
+
+public:
+	EvoEngine(std::uint32_t seed, unsigned _num_threads = 1);
+	EvoEngine(const EvoEngine&) = delete;
+
+	/*
+	 * Main search function.
+	 *
+	 * w_sch: inputs the initial RA Tree, outputs the final RA Tree
+	 * c:     the total cluster, including all cores on hardware
+	 */
+	void evo_search(WholeSch& w_sch, const Cluster& c);
+};
+
+#endif // EVO_H
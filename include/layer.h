@@ -1,6 +1,7 @@
 /* This file contains
  *	Layer:  base class for all network layers
  *  .*Layer: classes for each layer
+ *  FusedLayer: a layer fused with the single-input layers after it (see Network::fuse)
  *
  *  One can add new type of layers as classes here.
  */
@@ -9,7 +10,9 @@
 #define LAYER_H
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "util.h"
 
@@ -21,7 +24,7 @@
  * Example:
  *     a = LAYER("conv1", Conv, C=64, K=128, H=32, R=3)
  * defines a conv layer with a 3*3*64*128 kernel and 32*32*128 ofmap.
- * TYPE of a layer: Conv/FC/LR/Pooling/Eltwise
+ * TYPE of a layer: Conv/GroupConv/MatMul/FC/LR/Pooling/Eltwise/PTP/Transpose
  */
 
 #ifndef NO_FAST_INIT_LAYER
@@ -65,12 +68,26 @@ protected:
 	// Ifm_shape contains padding.
 	fmap_shape ifm_shape, ofm_shape, wgt_shape;
 
-	bwidth_t bitwidth; // Currently not used. Reserved for future use.
+	// Bitwidths of the ofmap and weights, 0 for the defaults.
+	bwidth_t bitwidth, wgt_bitwidth;
+
+	// Sparsity of weights, if set on this layer.
+	Sparsity sparsity;
+	bool own_sparsity;
 
 	Layer(const std::string& _name, const fmap_shape& _ifm_shape, const fmap_shape& _ofm_shape, const fmap_shape& _wgt_shape);
 	Layer(const std::string& _name);
 
+	// Copies the ofmap bitwidth of "act" and the weight bitwidth of "wgt".
+	void copy_bitwidth(const Layer& act, const Layer& wgt);
+
 public:
+	// Bitwidths of layers without their own (8 by default).
+	static bwidth_t default_bitwidth, default_wgt_bitwidth;
+	// Sparsity of weights in layers without their own (dense by default).
+	// Only applies to real weights, not weights from fmaps (see Node::hasFmapWgt).
+	static Sparsity default_sparsity;
+
 	const std::string& get_name() const;
 
 	utime_t get_utime() const;
@@ -81,9 +98,20 @@ public:
 	const fmap_shape& ofmap_shape() const;
 	const fmap_shape& weight_shape() const;
 
-	// Currently not used. Reserved for future use.
+	// Bitwidths of the ofmap and weights (the defaults if not set).
+	// Volumes of buffers, NoC and DRAM are counted in 8-bit units (see DataLayout::dataVol).
 	bwidth_t get_bitwidth() const;
+	bwidth_t get_wgt_bitwidth() const;
+	// Sets the bitwidths, 0 for the defaults.
 	void set_bitwidth(bwidth_t width);
+	void set_wgt_bitwidth(bwidth_t width);
+	// Whether any bitwidth is set on this layer.
+	bool has_bitwidth() const;
+
+	// Sparsity of weights (the default if not set).
+	const Sparsity& get_sparsity() const;
+	void set_sparsity(const Sparsity& sp);
+	bool has_sparsity() const;
 
 	// ifmap_shape with padding (if any)
 	virtual const fmap_shape& real_ifmap_shape() const =0;
@@ -118,6 +146,9 @@ public:
 	// e.g. false for ConvLayer(all C), true for LRLayer(C=K)
 	virtual bool fmap_channel_rel() const =0;
 
+	// The layer that reads the ifmap and weight, itself except in FusedLayer.
+	virtual const Layer& base_layer() const;
+
 	virtual ~Layer()=default;
 };
 
@@ -211,6 +242,48 @@ public:
 	virtual ~GroupConvLayer() override=default;
 };
 
+/*
+ * Batched matrix multiplication (e.g. Q*K^T and score*V in attention).
+ * Each group is a 1x1 GroupConv with M*1 ofmap, but the weight (B) is
+ * always a fmap: from prev layers and/or external data (e.g. KV cache),
+ * which are concatenated along the rows (H) of B.
+ */
+class MatMulLayer: public GroupConvLayer{
+public:
+	struct Workload{
+		/* Ifmap (A): G matrices of M*L, as (G*L)*M*1
+		 * Weight (B): G matrices of L*N, as (G*N)*L*1,
+		 *             or as (G*L)*N*1 if transB (e.g. K in Q*K^T)
+		 * Ofmap: G matrices of M*N, as (G*N)*M*1
+		 * // B batches in total, each with its own B matrices.
+		 */
+
+		/* Default:
+		 * G=1, transB=false
+		 *
+		 * Must init M, L, N
+		 */
+		len_t G=1,M,L,N;
+		bool transB=false;
+	};
+
+protected:
+	Workload wl;
+
+public:
+	MatMulLayer(const std::string& _name, const Workload& _wl);
+
+	const Workload& get_workload() const;
+
+	/*
+	 * Correspondance between weight and fmap_range(B,C,H,W) follows the shape of B:
+	 * C = N, H = L (or C = L, H = N if transB), W = 1
+	 */
+	virtual void ofm_to_wgt(fmap_range& ofm_range) const override;
+
+	virtual ~MatMulLayer() override=default;
+};
+
 class FCLayer: public ConvLayer{
 public:
 	struct Workload{
@@ -377,10 +450,46 @@ protected:
 public:
 	TransposeLayer(const std::string& _name, const Workload& _wl);
 
+	const Workload& get_workload() const;
+
 	virtual bool set_padded_ifm(const fmap_shape& padded_shape) override;
 	virtual void ofm_to_ifm(fmap_range& ofm_range) const override;
 
 	virtual ~TransposeLayer() override =default;
 };
 
+/*
+ * A layer (Conv/GroupConv/MatMul/FC) fused with the chain of single-input
+ * layers after it (PTP/Pooling), e.g. Conv + ReLU or MatMul + Softmax.
+ * Post layers are computed on the LR units of the same core, on the ofmap
+ * tile of the base layer, thus the intermediate fmaps never leave the core.
+ *
+ * Ifmap and weight are those of the base layer, and ofmap is that of the last post layer.
+ * Layers are shared with the network they come from.
+ */
+class FusedLayer: public Layer{
+	std::shared_ptr<const Layer> base;
+	std::vector<std::shared_ptr<const LRLayer>> posts;
+
+	// Maps ofmap range of the last post layer to ofmap range of the base layer.
+	void to_base_ofm(fmap_range& ofm_range) const;
+
+public:
+	FusedLayer(std::shared_ptr<const Layer> _base, std::vector<std::shared_ptr<const LRLayer>> _posts);
+
+	const Layer& get_base() const;
+	const std::vector<std::shared_ptr<const LRLayer>>& get_posts() const;
+
+	virtual const fmap_shape& real_ifmap_shape() const override;
+	virtual vol_t weight_size() const override;
+	virtual bool set_padded_ifm(const fmap_shape& padded_shape) override;
+	virtual access_t get_num_op(len_t batch_size=1) const override;
+	virtual void ofm_to_ifm(fmap_range& ofm_range) const override;
+	virtual void ofm_to_wgt(fmap_range& ofm_range) const override;
+	virtual bool fmap_channel_rel() const override;
+	virtual const Layer& base_layer() const override;
+
+	virtual ~FusedLayer() override =default;
+};
+
 #endif // LAYER_H
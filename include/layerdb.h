@@ -0,0 +1,91 @@
+/* This file contains
+ *	LayerDB: database of intra-layer search results.
+ *
+ *  LayerDB records the result of each StdLayerEngine::search (the chosen
+ *  partition & placement) and of each CoreMapper::genMapping (the tile mapping).
+ *  The database can be loaded from / appended to a file, so that later runs
+ *  on the same hardware can skip most of the intra-layer search.
+ *
+ *  All entries are keyed by the exact inputs of the search,
+ *  thus results are the same with or without LayerDB.
+ */
+
+#ifndef LAYERDB_H
+#define LAYERDB_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coremapping.h"
+#include "partition.h"
+#include "schnode.h"
+#include "util.h"
+
+
+class LayerDB{
+public:
+	// Keys are raw bytes of all search inputs.
+	typedef std::string key_t;
+
+	// Result of StdLayerEngine::search, enough to rebuild the LayerScheme.
+	struct SchEntry{
+		bool valid;
+		PartSch part;
+		std::uint8_t order[4];
+		SchNode::SchCost totCost;
+		energy_t extUbufEnergy;
+		CoreMapper::CoreMapping tileSch;
+	};
+
+	// Helpers to build a key.
+	template<typename T>
+	static void add_key(key_t& key, const T& val);
+	static void add_key(key_t& key, const std::string& str);
+
+private:
+	// Hash of the search context (hardware, cost function, ...).
+	// Only entries with the same context are loaded from the file.
+	const std::uint64_t ctx_hash;
+
+	mutable std::mutex mtx;
+	std::unordered_map<key_t, SchEntry> schemes;
+	std::unordered_map<key_t, CoreMapper::CoreMapping> mappings;
+
+	// Entries added in this run, which are appended to the file.
+	std::vector<key_t> new_schemes, new_mappings;
+
+	// Statistics.
+	mutable std::uint64_t sch_hit, sch_miss, map_hit, map_miss;
+
+public:
+	// "context" describes everything (except the keys) that affects search results.
+	LayerDB(const std::string& context);
+	LayerDB(const LayerDB&) = delete;
+
+	// 64-bit FNV-1a hash, stable among different runs.
+	static std::uint64_t hash(const std::string& str);
+
+	// Loads all entries with the same context from "file_name".
+	// Returns the number of loaded entries.
+	size_t load(const std::string& file_name);
+	// Appends all new entries to "file_name", returns whether succeeded.
+	bool save(const std::string& file_name) const;
+
+	bool find_scheme(const key_t& key, SchEntry& entry) const;
+	void add_scheme(const key_t& key, const SchEntry& entry);
+
+	bool find_mapping(const key_t& key, CoreMapper::CoreMapping& mapping) const;
+	void add_mapping(const key_t& key, const CoreMapper::CoreMapping& mapping);
+
+	void print_stats(std::ostream& os = std::cout) const;
+};
+
+template<typename T>
+void LayerDB::add_key(key_t& key, const T& val){
+	key.append(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+#endif // LAYERDB_H
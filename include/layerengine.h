@@ -2,6 +2,7 @@
  *	LayerScheme:    whole scheme of scheduling a layer
  *  LayerEngine:    base class for searching LayerScheme
  *  StdLayerEngine: standard implementation of LayerEngine
+ *  ApproxLayerEngine: cheap approximation of StdLayerEngine (for screening in SA)
  *
  *  One can add their own implementation of layer scheme searching as classes here.
  */
@@ -11,10 +12,14 @@
 
 #include "coremapping.h"
 #include "noc.h"
+#include "partition.h"
 #include "placement.h"
 #include "schnode.h"
 #include "util.h"
 
+class LayerDB;
+//#include "layerdb.h"
+
 
 struct LayerScheme{
 	// Total cost.
@@ -41,19 +46,65 @@ public:
 };
 
 class StdLayerEngine : public LayerEngine{
+	// Records search results, nullptr if not used.
+	LayerDB* db;
+
+	// Ranks partitions (e.g. by RooflineMapper), nullptr if not used.
+	CoreMapper* screen;
+	// Number of best-ranked partitions searched by mapper, 0 for all.
+	std::size_t screen_k;
+
+protected:
 	CoreMapper* mapper;
 
+	// Searches all partitions of *parts* and all their placements.
+	// If *approx*, only the first placement of each partition is tried,
+	// and the NoC of the scheme only counts total hops (no link bandwidth).
+	LayerScheme fullSearch(LNode* curNode, PartEngine& parts = partEngine, bool approx = false) const;
+
+	// Allocates layouts of *place* for the cluster and bitwidths of *curNode*.
+	void initPlaceSch(PlaceSch& place, const LNode* curNode) const;
+
 	// Sets placement *place* when partition *place.part* is fixed
 	void initLayouts(PlaceSch& place, const Node& layerT, const fmap_shape& ofmShape, len_t B) const;
 
 	// Calculates NoC *noc* from current placement *place*
 	void calcNoC(NoC& noc, const PlaceSch& place, LNode* curNode) const;
 
+	// Re-calculates placement & NoC of *layerSch* from its partition and order.
+	void finalizeScheme(LayerScheme& layerSch, LNode* curNode) const;
+
+	// Key of *curNode* in LayerDB, contains all inputs of fullSearch.
+	std::string dbKey(const LNode* curNode) const;
+
 public:
 	StdLayerEngine(CoreMapper* _mapper);
 
+	// Uses *_db* to record (and reuse) search results, also sets the db of mapper.
+	void set_db(LayerDB* _db);
+
+	// Ranks partitions by *_screen*, and only searches the best *k* partitions by mapper.
+	void set_screen(CoreMapper* _screen, std::size_t k);
+
 	virtual vol_t get_ubuf_size() const override;
 	virtual LayerScheme search(LNode* curNode) const override;
 };
 
+/*
+ * Approximate search, used to screen candidates in SA (see SAEngine::approx_engine).
+ * Only partitions with a higher utilization are searched (the best one if none),
+ * and only the first placement of each partition is tried.
+ * NoC only counts total hops, thus its time is only bounded by DRAM bandwidth.
+ * Results are not recorded in LayerDB.
+ */
+class ApproxLayerEngine : public StdLayerEngine{
+	// Partitions with utilization below min_util are skipped.
+	mutable PartEngine parts;
+
+public:
+	ApproxLayerEngine(CoreMapper* _mapper, double min_util = 0.9);
+
+	virtual LayerScheme search(LNode* curNode) const override;
+};
+
 #endif // LAYERENGINE_H
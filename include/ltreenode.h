@@ -3,22 +3,30 @@
  *      structural information like parent/child, type, num_batch,
  *      but no scheduling-scheme-related informations like
  *      core cluster, tiling, noc, ...)
+ *  UndoLog:   Records in-place changes of an RA Tree, for rollback.
  */
 
 #ifndef LTREENODE_H
 #define LTREENODE_H
 
+#include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "bitset.h"
 #include "util.h"
 
+class EvoEngine;
 class SAEngine;
+//#include "evo.h"
 //#include "sa.h"
 
 
 class LTreeNode{
+	friend class EvoEngine;
 	friend class SAEngine;
+	friend class UndoLog;
 
 public:
 	enum class NodeType : std::uint8_t{
@@ -73,6 +81,16 @@ private:
 	// traverse_pass2: sets "num_bgrp", "unit_time", "height", "to_dram" and "dirp_set".
 	void traverse_pass2();
 
+	// load_node/check_batch: Used in load()
+
+	// load_node: reads a subtree, drops unknown layers and collapses cuts with one child.
+	//     *ids*: layer name -> layer id. *loaded*: layers already read.
+	static LTreeNode* load_node(std::istream& is, const std::unordered_map<std::string, lid_t>& ids, Bitset& loaded);
+
+	// check_batch: checks that children of each cut have the same num_batch,
+	//     which is a divisor of num_batch of the cut.
+	bool check_batch() const;
+
 public:
 	LTreeNode(const Bitset& _layer_set, len_t _num_batch, LTreeNode* _parent=nullptr, NodeType _t=NodeType::L);
 	LTreeNode(lid_t _layer, len_t _num_batch, LTreeNode* _parent=nullptr);
@@ -91,6 +109,25 @@ public:
 	// Copy a new tree.
 	LTreeNode* copy() const;
 
+	/*
+	 * Saves the tree (after init_root) in prefix order, one node per line:
+	 *  T <num_batch> <#children>
+	 *  S <num_batch> <#children> <stage of each child>
+	 *  L <num_batch> <layer name>
+	 * Stages are only for reference, they are re-calculated in load().
+	 */
+	void save(std::ostream& os, std::string pad = "") const;
+
+	/*
+	 * Loads a tree saved by save() for the current network.
+	 * Layers are matched by name: unknown layers are dropped,
+	 * and missing layers are added after their last prev.
+	 * Returns nullptr if the tree does not fit the network,
+	 * throws std::invalid_argument if the format is wrong.
+	 * init_root() is called on the returned tree.
+	 */
+	static LTreeNode* load(std::istream& is, len_t tot_batch);
+
 	// Reset layer_set (for re-calculation)
 	void reset_lset();
 
@@ -108,4 +145,60 @@ public:
 	const Bitset& get_dirp_set() const;
 };
 
+/*
+ * UndoLog: Records in-place changes of an RA Tree.
+ *
+ * save(node) is called before any field of "node" is changed,
+ * nodes created/removed in the change are also recorded.
+ * Then the change is either kept by commit(), or undone by rollback().
+ */
+class UndoLog{
+	// All fields of one LTreeNode.
+	struct Entry{
+		LTreeNode* node;
+		LTreeNode::NodeType t;
+		bool isNewNode, modified;
+		len_t height;
+		LTreeNode* parent;
+		LTreeNode::node_vec children;
+		Bitset layer_set;
+		utime_t unit_time;
+		len_t num_bgrp, num_batch;
+		std::vector<lid_t> stage;
+		lid_t num_stage;
+		bool to_dram;
+		Bitset dirp_set;
+	};
+
+	// Only the first num_entries are used.
+	// Entries are reused among changes to keep the capacity of vectors.
+	std::vector<Entry> entries;
+	std::size_t num_entries;
+
+	// New nodes are deleted in rollback(), removed nodes are deleted in commit().
+	std::vector<LTreeNode*> created, removed;
+
+public:
+	UndoLog();
+	UndoLog(const UndoLog&) = delete;
+	// Keeps current changes.
+	~UndoLog();
+
+	// Records all fields of "node" before it is changed.
+	void save(LTreeNode* node);
+	// Records "node" and all its descendants.
+	// Used when types of the subtree will be re-calculated in init_root().
+	void save_subtree(LTreeNode* node);
+	// Records a new node.
+	void add_created(LTreeNode* node);
+	// Records a node removed from the tree, instead of deleting it.
+	// (Its children must be cleared)
+	void add_removed(LTreeNode* node);
+
+	// Keeps all changes.
+	void commit();
+	// Undoes all changes, then re-initializes and confirms the tree of "root".
+	void rollback(LTreeNode* root);
+};
+
 #endif // LTREENODE_H
@@ -2,13 +2,22 @@
  *	InputData: Describes the input data of the whole network.
  *  Node:      Represents a layer in the network.
  *  Network:   Represents a NN network.
+ *
+ *  Layers with the same type, workload, shapes and prev structure
+ *  (e.g. repeated blocks in ResNet or transformers) are in the same
+ *  shape class, and share all per-layer results (utime, LayerDB entries).
+ *
+ *  Network::fuse() folds single-input PTP/Pooling layers into the layer
+ *  producing their ifmap (see FusedLayer), which shrinks the search space of SA.
  */
 
 #ifndef NETWORK_H
 #define NETWORK_H
 
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "bitset.h"
@@ -38,12 +47,14 @@ public:
  * Here we use Node instead of directly using Layer, since
  * 1. There will be many kinds of derived class from layer (Conv, Pool, ...)
  *        where a single Node class is more friendly to Network.
- * 2. In the future one node may contain several layers,
+ * 2. One node may contain several layers (FusedLayer, see Network::fuse),
  *        which means in this way we can maintain compatibility.
  */
 class Node{
-	// The underlying layer.
-	std::unique_ptr<const Layer> l;
+	friend class Network;
+
+	// The underlying layer, shared by fused networks.
+	std::shared_ptr<const Layer> l;
 
 	// Previous layers.
 	const Bitset ifmPrevs; // previous inputs
@@ -56,8 +67,11 @@ class Node{
 	// #channels that comes from InputData
 	len_t external_C;
 
+	// #weight rows (H) that comes from InputData (in MatMul)
+	len_t external_wgt_H;
+
 public:
-	Node(const Layer* _l, const Bitset& _ifmPrevs, len_t _external_C, bwidth_t width = 0, const Bitset& _wgtPrevs = {});
+	Node(std::shared_ptr<const Layer> _l, const Bitset& _ifmPrevs, len_t _external_C, bwidth_t width = 0, const Bitset& _wgtPrevs = {}, len_t _external_wgt_H = 0);
 	Node(const Node& n) = delete;
 	Node(Node&& n)=default;
 
@@ -70,9 +84,13 @@ public:
 	const Bitset& get_nexts() const;
 	utime_t get_utime() const;
 	len_t get_external_C() const;
+	len_t get_external_wgt_H() const;
 
 	// Whether weight comes from prev layer's fmap (e.g. in GroupConv)
 	bool hasWgtPrevs() const;
+	// Whether weight is a fmap, from prev layers or InputData (e.g. KV cache in MatMul),
+	// thus differs among batches.
+	bool hasFmapWgt() const;
 
 	// Adds l to "nexts"
 	void add_next(lid_t l);
@@ -87,6 +105,22 @@ public:
 private:
 	std::vector<Node> layers;
 
+	// Shape class of each layer (the first layer in the class), and its signature.
+	std::vector<lid_t> shape_cls;
+	std::vector<std::string> shape_sigs;
+	// Signature -> shape class.
+	std::map<std::string, lid_t> sig_cls;
+
+	// Signature of the last added layer: everything that affects intra-layer search,
+	// except the layer name and ids.
+	std::string last_signature() const;
+	// Finds the shape class of the last added layer.
+	void add_shape_class();
+
+	// Whether layer "id" can be fused into the group of its only prev (see fuse()),
+	// with the groups (and the group of each layer) of layers before "id".
+	bool can_fuse(lid_t id, const std::vector<std::vector<lid_t>>& groups, const std::vector<std::size_t>& group_of) const;
+
 	// Used to check data range validity.
 	[[noreturn]] void err_mismatch(const std::string& lname, const fmap_shape& shape1, const fmap_shape& shape2, bool total=false);
 	[[noreturn]] void err_eltwise(const std::string& lname, const len_t from_C, const len_t add_C, const len_t elt_C);
@@ -102,14 +136,18 @@ public:
 	 * [input]
 	 *  l:        the layer to be added
 	 *  ifmPrevs: previous layers (for ifmap)
-	 *  width:    bitwidth (currently not used)
+	 *  width:    bitwidth of the ofmap (0 for Layer::default_bitwidth)
 	 *  ext_data: external data (input of the network)
-	 *  wgtPrevs: previous layers (for weight, used in GroupConv)
+	 *  wgtPrevs: previous layers (for weight, used in GroupConv and MatMul)
+	 *  ext_wgt:  external data for weight (only in MatMul, e.g. KV cache)
+	 *
+	 * Weights are concatenated along C, or along H (rows of B) in MatMul,
+	 * where ext_wgt comes before wgtPrevs.
 	 *
 	 * [output]
 	 *  index of the added layer
 	 */
-	lid_t add(const Layer* l, const layer_set& ifmPrevs={}, bwidth_t width=0, std::vector<InputData> ext_data={}, const layer_set& wgtPrevs={});
+	lid_t add(const Layer* l, const layer_set& ifmPrevs={}, bwidth_t width=0, std::vector<InputData> ext_data={}, const layer_set& wgtPrevs={}, std::vector<InputData> ext_wgt={});
 
 	// Get the i-th node.
 	const Node& getNode(lid_t id) const;
@@ -124,7 +162,38 @@ public:
 	// Checks whether direct edge "s->d" exists for any s in src, d in dst.
 	bool has_dep(const Bitset& src, const Bitset& dst) const;
 
-	// Sets the utime of each node/layer. (utime: NPT in SET paper)
+	// Bitwidths of the ifmap and weights of layer "id": the widest of their sources
+	// (prev layers, or the layer itself for external data and real weights).
+	bwidth_t ifm_bitwidth(lid_t id) const;
+	bwidth_t wgt_bitwidth(lid_t id) const;
+
+	// Shape class of layer "id", represented by the first layer in the class.
+	lid_t shape_class(lid_t id) const;
+	// Signature of the shape class of layer "id", the same for all networks.
+	const std::string& shape_sig(lid_t id) const;
+	// Number of distinct shape classes.
+	lid_t num_shape_classes() const;
+
+	/*
+	 * Finds the longest run of repeated blocks: layers [start, start + period*num),
+	 * where layer i + period has the same shape class as layer i,
+	 * and its prevs are those of layer i shifted by period.
+	 * Returns false if no block is repeated (num < 2).
+	 */
+	bool find_blocks(lid_t& start, lid_t& period, lid_t& num) const;
+
+	/*
+	 * Returns the network with layers fused: a PTP/Pooling layer whose only input
+	 * is the ofmap of a Conv/GroupConv/MatMul/FC layer (or a fused layer), which has
+	 * no other next layer, is folded into it as a FusedLayer.
+	 * Eltwise layers are not fused, since their other inputs are not in the ifmap
+	 * of the producing layer.
+	 *
+	 * Layers are shared with this network, and the order of layers is kept.
+	 */
+	Network fuse() const;
+
+	// Sets the utime of each node/layer, once for each shape class. (utime: NPT in SET paper)
 	void set_utime(const CoreMapper& mapper) const;
 
 	~Network()=default;
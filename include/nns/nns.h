@@ -28,14 +28,17 @@ extern const Network transformer;
 extern const Network transformer_cell;
 
 // For LLM a single block is provided for each network.
+// Full networks are empty unless Bitset is large enough (the default MAX_BITS is).
 // See comments in "nns/llm.cpp" for more detail.
 
-// extern const Network BERT;
+extern const Network BERT;
 extern const Network BERT_block;
-// extern const Network GPT2_prefill;
+extern const Network GPT2_prefill;
 extern const Network GPT2_prefill_block;
-// extern const Network GPT2_decode;
+extern const Network GPT2_decode;
 extern const Network GPT2_decode_block;
+// GPT2_decode_block with a KV cache of kv_len tokens.
+Network GPT2_decode_block_kv(len_t kv_len);
 
 extern const Network PNASNet;
 
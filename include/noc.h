@@ -117,6 +117,7 @@ public:
 
 	~NoC() = default;
 
+	// The sum only counts total hops if any of them does (calc_bw = false).
 	NoC operator+(const NoC& other) const;
 	NoC& operator+=(const NoC& other);
 	NoC operator*(const len_t& batch) const;
@@ -128,10 +129,14 @@ public:
 	// Clear all noc data.
 	void clear();
 
+	// Volumes are in the bitwidth of data in the layouts (see DataLayout::dataVol).
+
 	// DRAM -> toLayout
 	void fromRemoteMem(const DataLayout& toLayout);
 	// DRAM -> toLayout, only channels in [fromC, toC) is fetched
 	void fromRemoteMem(const DataLayout& toLayout, len_t fromC, len_t toC);
+	// DRAM -> toLayout, only rows in [fromH, toH) is fetched
+	void fromRemoteMemH(const DataLayout& toLayout, len_t fromH, len_t toH);
 	// fromLayout -> DRAM
 	void toRemoteMem(const UniqueLayout& fromLayout);
 	/*
@@ -140,8 +145,9 @@ public:
 	 * fromCOffset: channels in toLayout is padded by fromCOffset (fromCOffset+i is the ith channel)
 	 * fromB:       batch size of fromLayout (used in calc_intersect)
 	 * toB:         batch size of toLayout (used in calc_intersect)
+	 * fromHOffset: same as fromCOffset, for rows (used in MatMul weights)
 	 */
-	void betweenLayout(const UniqueLayout& fromLayout, const DataLayout& toLayout, len_t fromCOffset, len_t fromB, len_t toB);
+	void betweenLayout(const UniqueLayout& fromLayout, const DataLayout& toLayout, len_t fromCOffset, len_t fromB, len_t toB, len_t fromHOffset = 0);
 
 	// Getter functions.
 	cycle_t get_time() const;
@@ -59,6 +59,10 @@ struct PlaceSch{
 	// See "notes about finalize()" in datalayout.h
 	void finalize();
 
+	// Only compares "part" and "order".
+	// (Layouts are determined by them, with the same cluster and batch)
+	bool operator==(const PlaceSch& other) const;
+
 	friend std::ostream& operator<<(std::ostream& os, const PlaceSch& sch);
 };
 
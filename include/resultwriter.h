@@ -0,0 +1,72 @@
+/* This file contains
+ *	ResultWriter: Writes result files in background threads.
+ *
+ *  Each call of write() takes a snapshot (copy) of the scheme and the tree,
+ *  and queues jobs that write the summary/scheme/tree files and the IR.
+ *  Thus the search can go on while the (possibly huge) files are written.
+ */
+
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+
+class LTreeNode;
+//#include "ltreenode.h"
+class SchNode;
+//#include "schnode.h"
+
+
+class ResultWriter{
+	typedef std::function<void()> job_t;
+
+	// Prefix of all file names.
+	const std::string prefix;
+
+	std::vector<std::thread> workers;
+	std::deque<job_t> jobs;
+	// Number of jobs in "jobs" or running.
+	std::size_t num_pending;
+	bool stopping;
+
+	std::mutex mtx;
+	std::condition_variable job_cv, done_cv;
+
+	// Main loop of each worker.
+	void work();
+	// Adds a job to the queue.
+	void push(job_t&& job);
+
+public:
+	// Which files to write.
+	bool print_summary, print_scheme, print_tree;
+#ifndef NOT_GEN_IR
+	// Whether generates IR / replays IR in Simulator.
+	bool gen_IR, sim_IR;
+#endif
+
+	ResultWriter(const std::string& _prefix, unsigned num_threads = 2);
+	ResultWriter(const ResultWriter&) = delete;
+	// Waits for all jobs.
+	~ResultWriter();
+
+	/*
+	 * Writes files of "{prefix}{method}_*" in background.
+	 * "sch" and "tree" are copied, so they can be changed/deleted afterwards.
+	 * *with_IR*: whether generates IR (if gen_IR is set).
+	 */
+	void write(const std::string& method, const SchNode* sch, const LTreeNode* tree, bool with_IR = true);
+
+	// Waits until all queued jobs are done.
+	void wait();
+};
+
+#endif // RESULTWRITER_H
@@ -10,15 +10,25 @@
 #include <iostream>		// std::ostream
 #include <random>		// std::mt19937
 #include <sstream>		// std::ostringstream
+#include <string>		// std::string
 
 #include "util.h"
 
 class Cluster;
+class CoolingSchedule;
+class LayerEngine;
 class LTreeNode;
+class SchCache;
 class SchNode;
+class TransTable;
+class UndoLog;
 //#include "cluster.h"
+//#include "cooling.h"
+//#include "layerengine.h"
 //#include "ltreenode.h"
+//#include "schcache.h"
 //#include "schnode.h"
+//#include "transtable.h"
 
 
 struct WholeSch{
@@ -40,23 +50,44 @@ struct WholeSch{
 	WholeSch copy() const;
 	void del();
 	// Takes minimal with another tree.
-	// Will delete the other tree if it exists.
+	// Will delete the other tree if it exists, an empty tree is ignored.
 	void min(WholeSch& w_sch);
 };
 
 class SAEngine{
 public:
+	// SA has 7 OPs (OP1 in SET paper is divided into two OPs <- this can be optimized)
+	static constexpr int NUM_OP = 7;
 	// Total #rounds of SA.
 	static int nrounds;
+	// Capacity of the subtree cache of each engine.
+	static std::size_t cache_size;
+	// Transposition table used in SA_search.
+	// 0 -> none. 1 -> one table for each SA_search. 2 -> shared_table.
+	static int table_mode;
+	// Whether OPs are picked adaptively (see pick_op), instead of by fixed weights.
+	static bool adaptive_op;
+	// Name of the cooling schedule (see CoolingSchedule::newSchedule).
+	static std::string cooling_name;
+	// If not nullptr, new RA Trees are first scheduled by approx_engine,
+	// and only those accepted under the approximate cost are scheduled exactly.
+	static LayerEngine* approx_engine;
 
 private:
-	// SA has 7 OPs (OP1 in SET paper is divided into two OPs <- this can be optimized)
-	static constexpr int NUM_OP = 7;
-
 	// Halves all batch sizes under node.
-	static void halv_bat(LTreeNode* node);
+	static void halv_bat(LTreeNode* node, UndoLog& log);
 	// Reduce all batch sizes under node to n_batch, do not change if less.
-	static void flat_bat(LTreeNode* node, len_t n_batch = 1);
+	static void flat_bat(LTreeNode* node, UndoLog& log, len_t n_batch = 1);
+
+	// Transposition table shared by all engines (all threads).
+	static TransTable shared_table;
+
+	// Fixed weights of OPs.
+	static const int op_weight[NUM_OP];
+	// Decay of the average reward in adaptive OP selection.
+	static constexpr double op_decay = 0.05;
+	// Part of probability shared equally by all OPs (for exploration).
+	static constexpr double op_explore = 0.2;
 
 	// Current round
 	int cur_round;
@@ -68,6 +99,16 @@ private:
 	// Random generator
 	std::mt19937 generator;
 
+	// Subtrees built by this engine, kept among SA_search calls.
+	SchCache* cache;
+
+	// Average reward of each OP in adaptive OP selection,
+	// the reward is the relative cost improvement per layer search.
+	double op_reward[NUM_OP];
+
+	// Cooling schedule of current SA_search.
+	CoolingSchedule* cooling;
+
 	// Output buffer used in multithreading
 	// (sync flush to avoid concurrent cout)
 	std::ostringstream strStream;
@@ -80,15 +121,33 @@ private:
 	// Bernoulli variable with probability "prob".
 	bool withProb(double prob);
 
+	// Probability of each OP (among valid OPs).
+	void op_prob(const bool* valid_op, double* prob) const;
+	// Picks a random OP, either by fixed weights or adaptively.
+	int pick_op(const bool* valid_op);
+	// Updates the average reward of "op".
+	void update_op(int op, double reward);
+
+	// Schedules "tree" on cluster "c", reusing results of "cur_res" (the scheme before change).
+	SchNode* schedule(LTreeNode* tree, const SchNode* cur_res, const Cluster& c);
+	// Same as schedule(), but layers are searched by approx_engine.
+	// "cur_approx" must also be scheduled by approx_engine (or nullptr/invalid to schedule from scratch).
+	SchNode* schedule_approx(LTreeNode* tree, const SchNode* cur_approx, const Cluster& c);
+
 	// Used for printing status each minute (in a separate ping thread).
 	// void ping_func(volatile bool& stop) const;
 
 public:
 	SAEngine(std::uint32_t seed, bool directCout = false);
+	SAEngine(const SAEngine&) = delete;
+	~SAEngine();
 
 	// Prints buffered messages (in strStream) to cout
 	void flushBuf();
 
+	// Clears results shared by all engines, must be called before switching networks.
+	static void clear_shared();
+
 	/*
 	 * Main search function for SA
 	 *
@@ -99,18 +158,12 @@ public:
 	 */
 	void SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth=0, int sa_type=0);
 
-	// Change current tree (according to the OPs in SA)
-	LTreeNode* sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth=0, int sa_type=0, int* op_type=nullptr);
+	// Change current tree in place (according to the OPs in SA)
+	// All changes are recorded in "log".
+	void sa_change(LTreeNode* root, UndoLog& log, bool* valid_op, lid_t max_depth=0, int sa_type=0, int* op_type=nullptr);
 
 	// Determines whether SA accepts new scheme.
 	bool sa_accept(cost_t cur_cost, cost_t new_cost, int round);
 };
 
-/*
- * [Deprecated]
- * Search LP by Dynamic Programming (DP).
- * Deprecated since in general it's hard to perform DP on general RA Trees.
- */
-void LP_search(lid_t num_layer, len_t tot_batch, Cluster& c, WholeSch& w_sch, bool has_S, bool has_T);
-
 #endif // SA_H
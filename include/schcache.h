@@ -0,0 +1,86 @@
+/* This file contains
+ *	SchCache: A bounded LRU cache of built SchNode subtrees.
+ *
+ *  SA often goes back to subtrees it has scheduled many rounds ago,
+ *  which are no longer in the previous scheme (see Cut::searchInc).
+ *  SchCache keeps copies of recently built S/T subtrees, keyed by
+ *  the structure of the subtree and all conditions from outside the subtree.
+ *  A subtree with the same key is spliced in by copy() instead of rebuilt,
+ *  thus schemes are the same with or without SchCache.
+ */
+
+#ifndef SCHCACHE_H
+#define SCHCACHE_H
+
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "bitset.h"
+#include "util.h"
+
+class Cluster;
+class Cut;
+class LTreeNode;
+class SchNode;
+//#include "cluster.h"
+//#include "ltreenode.h"
+//#include "schnode.h"
+
+
+class SchCache{
+public:
+	// Keys are raw bytes of the subtree and its boundary conditions.
+	typedef std::string key_t;
+
+private:
+	typedef std::list<std::pair<key_t, SchNode*>> entry_list;
+
+	// Maximal number of cached subtrees.
+	const std::size_t capacity;
+	// Most recently used first.
+	entry_list entries;
+	std::unordered_map<key_t, entry_list::iterator> index;
+
+	// Statistics.
+	std::uint64_t num_hit, num_miss;
+
+	template<typename T>
+	static void add_key(key_t& key, const T& val);
+	// Adds the structure of "node", and the external inputs of its LNodes.
+	static bool add_subtree(key_t& key, LTreeNode* node, const Bitset& layers, const Cut* parent);
+
+public:
+	SchCache(std::size_t _capacity);
+	SchCache(const SchCache&) = delete;
+	~SchCache();
+
+	/*
+	 * Key of the subtree "node", to be built on cluster "c" under "parent".
+	 * The key contains:
+	 *  - whether "parent" is a DRAM cut, and cluster "c".
+	 *  - type, batch and stages of each node in the subtree,
+	 *    dirp_set and to_dram of each L node.
+	 *  - cluster, batch and placement of each direct prev outside the subtree.
+	 * Returns false if the key can't be made (a direct prev is not built).
+	 */
+	static bool make_key(LTreeNode* node, const Cluster& c, const Cut* parent, key_t& key);
+
+	// Returns the cached subtree with "key", or nullptr if not found.
+	const SchNode* find(const key_t& key);
+	// Caches a copy of "sch".
+	void add(const key_t& key, const SchNode* sch);
+
+	void clear();
+	void print_stats(std::ostream& os = std::cout) const;
+};
+
+template<typename T>
+void SchCache::add_key(key_t& key, const T& val){
+	key.append(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+#endif // SCHCACHE_H
@@ -31,11 +31,13 @@
 #include "util.h"
 
 class LayerEngine;
+class SchCache;
 class StdLayerEngine;
 namespace Json{
 	class Value;
 };
 //#include "layerengine.h"
+//#include "schcache.h"
 //#include "json/json.h"
 
 
@@ -43,6 +45,8 @@ class LNode;
 class Cut;
 
 class SchNode{
+	friend class SchCache;
+
 public:
 	typedef SchNode* sn_ptr;
 	typedef const SchNode* csn_ptr;
@@ -94,20 +98,53 @@ protected:
 	// All SchNodes on the tree shares one lnodeList, managed by the root.
 	nodeList_t* const lnodeList;
 
+	// lnodeList of an old scheme, whose LNodes can be reused (per thread).
+	// See LNode::findReusable().
+	static thread_local const nodeList_t* reuseList;
+	// Cache of built subtrees (per thread), see Cut::buildNode().
+	static thread_local SchCache* subCache;
+	// Number of layer searches (calls of layerMapper) by this thread.
+	static thread_local std::uint64_t searchCount;
+	// Replaces layerMapper in this thread, nullptr if not used.
+	static thread_local LayerEngine* threadMapper;
+
 	SchNode(const SchNode& node) = default;
 
+	// See quick_check(_node, _c). "wgt_vol" returns the weight volume kept in "node".
+	static bool quick_check(LTreeNode* node, const Cluster& c, bool is_top, bool is_seg, vol_t& wgt_vol);
+
 public:
 	// Factory function.
 	// Constructs a SchNode corresponding to the LTreeNode object "_node".
 	// The derived class type and initilization will perform accordingly.
 	static sn_ptr newNode(LTreeNode *_node, const Cluster& _c, Cut* parent);
 
+	/*
+	 * Fast feasibility check, without searching any layer.
+	 * Returns false only if newNode(_node, _c, nullptr) is surely invalid:
+	 *  - sub-clusters of an S cut can't be allocated (Cluster::try_alloc), or
+	 *  - weights kept in a node exceed the total buffer of its cluster.
+	 */
+	static bool quick_check(LTreeNode* _node, const Cluster& _c);
+
 	SchNode(NodeType t, const Cluster& _c, cut_ptr _parent, len_t nbatch);
 	virtual ~SchNode() =0;
 
 	// Used to set a new parent for this. See the implementation of copy().
 	void setParent(Cut* newParent);
 
+	// Search results of LNodes in "old" will be reused by new LNodes
+	// of this thread, if the same layer is searched under the same conditions.
+	// "old" must be kept until setReuse(nullptr) is called.
+	static void setReuse(const SchNode* old);
+	// S/T subtrees built by this thread will be looked up in/added to "cache".
+	static void setCache(SchCache* cache);
+	// Number of layer searches by this thread, can be used as a cost of scheduling.
+	static std::uint64_t getSearchCount();
+	// Layers built by this thread will be searched by "mapper" instead of layerMapper
+	// (nullptr to restore). Reuse and cache must not mix schemes of different mappers.
+	static void setMapper(LayerEngine* mapper);
+
 	// Incremental search (reuse old results if possible)
 	virtual void searchInc(LTreeNode* node) =0;
 
@@ -152,23 +189,14 @@ protected:
 	typedef std::uint32_t wlid_t;
 	typedef std::uint32_t tfid_t;
 
-	static wlid_t workload_cnt;
-	static tfid_t transferid_cnt;
-	static std::vector<std::vector<std::vector<jsonindex_t> > > wlid;
-	static std::vector<bool> from_core, weight_from_core, to_dram;
-	static std::vector<std::map<fmap_range, jsonindex_t> > ofmapid;
-	static std::vector<std::set<Json::Value> > curr_ifmap;
-	static std::vector<std::set<Json::Value> > curr_weight;
-	static std::map<std::string,lid_t> name_to_id;
-	static Json::Value DRAM;
-	static std::map<Json::Value,jsonindex_t> DRAM_ofmap_pos;
-	static std::map<Json::Value,jsonindex_t> DRAM_weight_pos;
-	static std::map<tfid_t,jsonindex_t> DRAM_ifmap_pos;
-	static csn_ptr root;
+	// All states of one IR generation, see schnode.cpp.
+	struct IRContext;
 
 public:
+	// Generates the IR of the scheme rooted at this node.
+	// Reentrant: each call keeps its states in a local IRContext.
 	Json::Value IR_gen() const;
-	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const = 0;
+	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const = 0;
 	virtual const LNode* get_lnode_by_id(lid_t id) const = 0;
 #endif
 };
@@ -183,6 +211,12 @@ private:
 	const Bitset dirp_set;           // Direct prev layers (for shortcut)
 	const bool to_dram;              // whether writes results to DRAM
 	CoreMapper::CoreMapping tileSch; // scheduling scheme of this layer (tiling, etc.)
+	SchCost search_cost;             // cost returned by layerMapper
+	energy_t ext_ubuf_energy;        // ubuf energy returned by layerMapper
+
+	// Finds an old LNode in reuseList with the same search conditions.
+	// The conditions are: cluster, batch, dirp_set, to_dram and layouts of dirp_set.
+	const LNode* findReusable() const;
 
 	// Search for intra-layer scheme
 	bool search();
@@ -212,7 +246,7 @@ public:
 #ifndef NOT_GEN_IR
 	// **************** Code for IR generation ****************
 	static const Cut* get_lca(const LNode* node1, const LNode* node2);
-	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const override;
+	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const override;
 	virtual const LNode* get_lnode_by_id(lid_t id) const override;
 #endif
 };
@@ -231,6 +265,9 @@ protected:
 	// Iteratively construct all childs while updating *this
 	virtual void construct(LTreeNode* node) =0;
 
+	// Builds a new child, or copies it from subCache.
+	sn_ptr buildNode(LTreeNode* _node, const Cluster& _c);
+
 public:
 	Cut(NodeType t, LTreeNode* node, const Cluster& _c, cut_ptr _parent);
 	virtual ~Cut() override;
@@ -274,7 +311,7 @@ public:
 
 #ifndef NOT_GEN_IR
 	// **************** Code for IR generation ****************
-	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const override;
+	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const override;
 #endif
 };
 
@@ -293,7 +330,7 @@ public:
 
 #ifndef NOT_GEN_IR
 	// **************** Code for IR generation ****************
-	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const override;
+	virtual void add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const override;
 #endif
 };
 
@@ -0,0 +1,137 @@
+/* This file contains
+ *	Simulator: Event-driven replay of the generated IR.
+ *
+ *  The simulator consumes the IR of SchNode::IR_gen() and replays it
+ *  on the mesh, in order to check the latency predicted by the cost model.
+ *
+ *  Model:
+ *   - Each core runs its workloads sequentially, in the order of the IR.
+ *     A workload starts when the previous one finishes and all
+ *     transfers destined to it have arrived.
+ *   - A transfer from a core is sent when the producing workload finishes.
+ *     A transfer from DRAM is sent when all DRAM writes it reads from are done,
+ *     and each destination core has started the workload before the consumer
+ *     (one workload of prefetch, i.e. double buffering).
+ *   - Transfers reserve all links on their XY routes (multicast uses the union
+ *     of routes) and the DRAM bandwidth in the order they are sent.
+ *     DRAM traffic is interleaved on all DRAM ports, as in NoC.
+ *   - Buffer capacity is not modeled.
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "util.h"
+
+#ifndef NOT_GEN_IR
+
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include "json/json.h"
+
+
+class Simulator{
+	// Time in cycles (fractional, since transfers take size/bw cycles).
+	typedef double stime_t;
+	typedef std::size_t idx_t;
+
+	struct Workload{
+		// Core, and position in the workload list of the core.
+		idx_t core, pos;
+		stime_t time;
+		// Transfers sent when this workload finishes.
+		std::vector<idx_t> outputs;
+		// DRAM transfers to the next workload, which can be sent after this one starts.
+		std::vector<idx_t> prefetches;
+		// Number of transfers not arrived yet.
+		idx_t pending_inputs;
+		stime_t start, finish;
+	};
+
+	struct Transfer{
+		// Size in bytes.
+		double size;
+		// Source core, num_cores for DRAM.
+		idx_t src;
+		std::vector<idx_t> dst_cores;
+		std::vector<idx_t> dst_workloads;
+		bool to_dram;
+		// DRAM transfers which read the data written by this transfer.
+		std::vector<idx_t> readers;
+		// Whether the source data is ready.
+		bool src_ready;
+		// Number of DRAM writes / prefetch windows to wait for.
+		idx_t pending_writes, pending_windows;
+		bool sent;
+		stime_t finish;
+	};
+
+	struct Core{
+		pos_t pos;
+		std::vector<idx_t> workloads;
+		// Index of next workload in "workloads".
+		idx_t next;
+		bool busy;
+		stime_t busy_time;
+	};
+
+	enum class EventType : std::uint8_t{
+		WorkloadDone,
+		TransferDone
+	};
+
+	struct Event{
+		stime_t time;
+		// For a stable order among events at the same time.
+		std::uint64_t seq;
+		EventType type;
+		idx_t idx;
+
+		// Reversed, so that std::priority_queue pops the earliest event.
+		bool operator<(const Event& other) const;
+	};
+
+	mlen_t xlen, ylen;
+
+	std::vector<Core> cores;
+	std::vector<Workload> workloads;
+	std::vector<Transfer> transfers;
+
+	// Time when each link / DRAM becomes free, and total busy time.
+	std::vector<stime_t> link_free, link_busy;
+	stime_t dram_free, dram_busy;
+
+	std::priority_queue<Event> events;
+	std::uint64_t event_cnt;
+	stime_t cur_time, makespan;
+
+	// Transfers/workloads referred in IR but not found.
+	idx_t num_missing;
+
+	// Index of link from (x, y) to direction dir (ESWN = 0123).
+	std::size_t link_idx(mlen_t x, mlen_t y, mlen_t dir) const;
+	// Marks all links on the XY route of src -> dst.
+	void mark_route(pos_t src, pos_t dst, std::vector<bool>& mark) const;
+
+	void push_event(stime_t time, EventType type, idx_t idx);
+	// Starts the next workload of core "c" if possible.
+	void try_start(idx_t c);
+	// Sends transfer "t" if possible.
+	void try_send(idx_t t);
+
+public:
+	// Reads workloads and transfers from the IR.
+	Simulator(const Json::Value& IR);
+
+	// Replays the IR, returns the makespan.
+	cycle_t run();
+
+	// Prints the simulation results, compared with the predicted latency.
+	void print_report(cycle_t predicted, std::ostream& os = std::cout) const;
+};
+
+#endif // NOT_GEN_IR
+
+#endif // SIMULATOR_H
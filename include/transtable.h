@@ -0,0 +1,72 @@
+/* This file contains
+ *	TransTable: Transposition table of RA Trees evaluated in SA.
+ *
+ *  SA often goes back to RA Trees it has evaluated before (most of them
+ *  are rejected). TransTable maps the fingerprint of a whole RA Tree
+ *  to its validity and cost, so that SA_search only schedules
+ *  a known RA Tree again when it is kept (accepted or a new minimum).
+ *
+ *  The fingerprint is a 128-bit hash of the tree structure (type, batch
+ *  and layer of each node) and the cluster, which determine the scheme.
+ */
+
+#ifndef TRANSTABLE_H
+#define TRANSTABLE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "schnode.h"
+#include "util.h"
+
+class Cluster;
+class LTreeNode;
+//#include "cluster.h"
+//#include "ltreenode.h"
+
+
+class TransTable{
+public:
+	typedef std::pair<std::uint64_t, std::uint64_t> fp_t;
+
+	struct Entry{
+		bool valid;
+		SchNode::SchCost cost;
+	};
+
+	// Default maximal number of entries, the table is cleared when full.
+	static constexpr std::size_t default_capacity = 1 << 18;
+
+private:
+	struct fp_hash{
+		std::size_t operator()(const fp_t& fp) const;
+	};
+
+	// Whether the table is shared among threads (and needs locking).
+	const bool shared;
+	const std::size_t capacity;
+
+	std::mutex mtx;
+	std::unordered_map<fp_t, Entry, fp_hash> table;
+
+	static void add_tree(std::string& key, LTreeNode* node);
+
+public:
+	TransTable(bool _shared, std::size_t _capacity = default_capacity);
+	TransTable(const TransTable&) = delete;
+
+	// Fingerprint of the RA Tree "root" (after init_root()) on cluster "c".
+	static fp_t fingerprint(LTreeNode* root, const Cluster& c);
+
+	// Returns whether "fp" is found, and sets "entry" if found.
+	bool find(const fp_t& fp, Entry& entry);
+	// Adds or replaces the entry of "fp".
+	void add(const fp_t& fp, const Entry& entry);
+
+	void clear();
+};
+
+#endif // TRANSTABLE_H
@@ -163,4 +163,26 @@ struct fmap_range{
 	friend std::ostream& operator<<(std::ostream& os, const fmap_range& range);
 };
 
+/* Structured sparsity of weights (dense by default).
+ * N:M:   N nonzero weights in each group of M, each stored with its index in the group.
+ * Block: only "density" of the weight blocks are nonzero (block indices are not counted).
+ * Both can be combined (N:M inside the nonzero blocks).
+ * Zero weights are neither stored, sent nor computed.
+ */
+struct Sparsity{
+	len_t N, M;
+	double density;
+
+	Sparsity();
+	Sparsity(len_t _N, len_t _M, double _density = 1);
+
+	bool is_dense() const;
+	// Fraction of weights (and MACs) that are kept.
+	double get_density() const;
+	// Size (in bits) of "num" dense weights of "width" bits after compression.
+	vol_t bits(vol_t num, bwidth_t width) const;
+
+	friend std::ostream& operator<<(std::ostream& os, const Sparsity& sp);
+};
+
 #endif // UTIL_H
@@ -0,0 +1,194 @@
+#include "blocks.h"
+
+#include <sstream>		// std::ostringstream, std::istringstream
+#include <stdexcept>	// std::invalid_argument
+#include <string>		// std::to_string
+#include <utility>		// std::pair
+#include <vector>		// std::vector
+
+#include "cluster.h"
+#include "ltreenode.h"
+#include "network.h"
+#include "sa.h"			// WholeSch
+#include "schnode.h"
+
+
+BlockStitcher::BlockStitcher(const Network& _full, const Network& _block)
+	:full(_full), block(_block), start(0), period(0), num(0){
+	if(!full.find_blocks(start, period, num)){
+		throw std::invalid_argument("No repeated blocks found in the network!");
+	}
+	if(block.len() + (num - 1) * period != full.len()){
+		throw std::invalid_argument("The block network is not the network with one block! (found "
+									+ std::to_string(num) + " blocks of " + std::to_string(period)
+									+ " layers from layer " + std::to_string(start) + ")");
+	}
+
+	// Each layer of "block" (with its prevs) is the same as in the first copy
+	// (or the last copy, for layers after the blocks).
+	for(lid_t i = 0; i < block.len(); ++i){
+		lid_t k = (i < start + period) ? 0 : num - 1;
+		auto to_full = [&](lid_t id){
+			return (id < start) ? id : map_id(id, k);
+		};
+		lid_t id = to_full(i);
+		Bitset prevs;
+		FOR_BITSET(prev, block[i].getPrevs()){
+			prevs.set(to_full(prev));
+		}
+		if(block.shape_sig(i) != full.shape_sig(id) || !(prevs == full[id].getPrevs())){
+			throw std::invalid_argument("The block network is not the network with one block! (layer "
+										+ block[i].name() + " differs from " + full[id].name() + ")");
+		}
+	}
+}
+
+lid_t BlockStitcher::get_num() const{
+	return num;
+}
+
+lid_t BlockStitcher::get_period() const{
+	return period;
+}
+
+lid_t BlockStitcher::map_id(lid_t id, lid_t k) const{
+	if(id < start) return (k == 0) ? id : full.len();
+	if(id < start + period) return id + k * period;
+	return (k == num - 1) ? id + (num - 1) * period : full.len();
+}
+
+bool BlockStitcher::has_layers(LTreeNode* node, lid_t k) const{
+	if(node->get_type() == LTreeNode::NodeType::L){
+		return map_id(node->layers().first(), k) != full.len();
+	}
+	for(auto child : node->get_children()){
+		if(has_layers(child, k)) return true;
+	}
+	return false;
+}
+
+void BlockStitcher::write_node(std::ostream& os, LTreeNode* node, lid_t k) const{
+	LTreeNode::NodeType t = node->get_type();
+	if(t == LTreeNode::NodeType::L){
+		os << "L " << node->get_tot_batch() << ' ' << full[map_id(node->layers().first(), k)].name() << std::endl;
+		return;
+	}
+
+	LTreeNode::node_vec children;
+	for(auto child : node->get_children()){
+		if(has_layers(child, k)) children.push_back(child);
+	}
+	write_cut(os, t, node->get_tot_batch(), children.size());
+	for(auto child : children){
+		write_node(os, child, k);
+	}
+}
+
+void BlockStitcher::write_cut(std::ostream& os, LTreeNode::NodeType t, len_t batch, std::size_t num_children){
+	os << (t == LTreeNode::NodeType::S ? "S " : "T ") << batch << ' ' << num_children;
+	// Stages are re-calculated in LTreeNode::load().
+	if(t == LTreeNode::NodeType::S){
+		for(std::size_t i = 0; i < num_children; ++i) os << " 0";
+	}
+	os << std::endl;
+}
+
+LTreeNode* BlockStitcher::stitch_tree(LTreeNode* block_tree, bool merge) const{
+	typedef std::pair<LTreeNode*, lid_t> item_t;
+
+	// Type of the cut merging x and y: the type of y (or x) if it is a cut, otherwise S.
+	auto merged_type = [](const item_t& x, const item_t& y){
+		if(y.first->get_type() != LTreeNode::NodeType::L) return y.first->get_type();
+		if(x.first->get_type() != LTreeNode::NodeType::L) return x.first->get_type();
+		return LTreeNode::NodeType::S;
+	};
+	// Children of "item" in a cut of type t: children of "item" if it is also of type t.
+	auto parts = [&](const item_t& item, LTreeNode::NodeType t){
+		LTreeNode::node_vec nodes;
+		if(item.first->get_type() != t){
+			nodes.push_back(item.first);
+			return nodes;
+		}
+		for(auto child : item.first->get_children()){
+			if(has_layers(child, item.second)) nodes.push_back(child);
+		}
+		return nodes;
+	};
+	// Whether x and y can be merged (all children have the same batch size).
+	auto can_merge = [&](const item_t& x, const item_t& y){
+		LTreeNode::NodeType t = merged_type(x, y);
+		auto x_parts = parts(x, t);
+		auto y_parts = parts(y, t);
+		len_t batch = x_parts.front()->get_tot_batch();
+		for(auto node : y_parts){
+			if(node->get_tot_batch() != batch) return false;
+		}
+		return true;
+	};
+
+	// Children of the root: one item, or two merged items (at a block boundary).
+	std::vector<std::vector<item_t>> entries;
+	bool merged = false;
+	for(lid_t k = 0; k < num; ++k){
+		bool first = true;
+		for(auto child : block_tree->get_children()){
+			if(!has_layers(child, k)) continue;
+			item_t item(child, k);
+			if(merge && first && !entries.empty() && entries.back().size() == 1 && can_merge(entries.back().front(), item)){
+				entries.back().push_back(item);
+				merged = true;
+			}else{
+				entries.push_back({item});
+			}
+			first = false;
+		}
+	}
+	if(merge && !merged) return nullptr;
+
+	std::ostringstream os;
+	write_cut(os, LTreeNode::NodeType::T, block_tree->get_tot_batch(), entries.size());
+	for(const auto& entry : entries){
+		if(entry.size() == 1){
+			write_node(os, entry[0].first, entry[0].second);
+			continue;
+		}
+		const item_t& x = entry[0];
+		const item_t& y = entry[1];
+		LTreeNode::NodeType t = merged_type(x, y);
+		auto x_parts = parts(x, t);
+		auto y_parts = parts(y, t);
+		write_cut(os, t, MAX(x.first->get_tot_batch(), y.first->get_tot_batch()), x_parts.size() + y_parts.size());
+		for(auto node : x_parts) write_node(os, node, x.second);
+		for(auto node : y_parts) write_node(os, node, y.second);
+	}
+
+	std::istringstream is(os.str());
+	return LTreeNode::load(is, block_tree->get_tot_batch());
+}
+
+WholeSch BlockStitcher::stitch(const WholeSch& block_sch, const Cluster& c) const{
+	WholeSch best;
+	for(bool merge : {false, true}){
+		const char* name = merge ? "merged boundaries" : "stitched";
+		LTreeNode* tree = stitch_tree(block_sch.tree, merge);
+		if(tree == nullptr){
+			if(merge) std::cout << "Blocks: no boundary can be merged." << std::endl;
+			continue;
+		}
+		SchNode* sch = nullptr;
+		if(SchNode::quick_check(tree, c)){
+			sch = SchNode::newNode(tree, c, nullptr);
+		}
+		if(sch == nullptr || !sch->is_valid()){
+			std::cout << "Blocks: " << name << " tree is not valid." << std::endl;
+			delete tree;
+			delete sch;
+			continue;
+		}
+		std::cout << "Blocks: " << name << ": " << sch << std::endl;
+		tree->confirm();
+		WholeSch cur(tree, sch);
+		best.min(cur);
+	}
+	return best;
+}
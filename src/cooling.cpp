@@ -0,0 +1,84 @@
+#include "cooling.h"
+
+#include <cmath>
+#include <stdexcept>
+
+
+/* #################### CoolingSchedule #################### */
+
+void CoolingSchedule::update(double x, double delta, bool accepted, bool new_min){
+	(void) x;
+	(void) delta;
+	(void) accepted;
+	(void) new_min;
+}
+
+CoolingSchedule* CoolingSchedule::newSchedule(const std::string& name, int nrounds){
+	if(name == "fixed") return new FixedCooling();
+	if(name == "adaptive") return new AdaptiveCooling(nrounds);
+	throw std::invalid_argument("Cooling schedule \"" + name + "\" not recognized!");
+}
+
+
+/* #################### FixedCooling #################### */
+
+double FixedCooling::temperature(double x) const{
+	/*
+	 * T(x) = a+c/(b+x)
+	 *
+	 * want:
+	 * a + c/b = 0.1
+	 * a + c/(b+0.5) = 0.01
+	 * a + c/(b+1) = 0
+	 *
+	 * thus:
+	 * a = -1 / 80
+	 * b = 0.01*0.5/(0.1*0.5-0.01) = 0.125
+	 * c = 9 / 640
+	 * T(x) = 1/10 * (1-x)/(1+8x)
+	 */
+	// Since only 1/100 are good, multiply T by 0.7:
+	return 0.07 * (1-x)/(1+8*x);
+}
+
+
+/* #################### AdaptiveCooling #################### */
+
+AdaptiveCooling::AdaptiveCooling(int nrounds)
+	:calib_num(MAX(nrounds/50, 20)), stall(MAX(nrounds/20, 50)),
+	 num_worse(0), avg_delta(0), avg_accept(p0), scale(1), num_stall(0){}
+
+double AdaptiveCooling::target(double x){
+	return p0 * (1-x)/(1+8*x);
+}
+
+double AdaptiveCooling::temperature(double x) const{
+	if(num_worse < calib_num) return fixed.temperature(x);
+	double t = target(x);
+	if(t <= 0) return 0;
+	return -scale * avg_delta / std::log(t);
+}
+
+void AdaptiveCooling::update(double x, double delta, bool accepted, bool new_min){
+	if(delta > 0){
+		++num_worse;
+		if(num_worse <= calib_num){
+			// Calibration: plain average of the first deltas.
+			avg_delta += (delta - avg_delta) / num_worse;
+		}else{
+			avg_delta += decay * (delta - avg_delta);
+			avg_accept += decay * ((accepted ? 1 : 0) - avg_accept);
+			// Accepts too few -> heat up, too many -> cool down.
+			scale *= std::exp(gain * (target(x) - avg_accept) / p0);
+			scale = MIN(scale, max_scale);
+		}
+	}
+
+	if(new_min){
+		num_stall = 0;
+	}else if(++num_stall >= stall){
+		// Reheat.
+		num_stall = 0;
+		scale = MIN(MAX(scale, 1.0) * 2, max_scale);
+	}
+}
@@ -3,9 +3,18 @@
 #include <cassert>
 
 
+static std::ostream& operator<<(std::ostream& os, const Core::Buffer& buf){
+	return os << buf.Size << ' ' << buf.RCost << ' ' << buf.WCost << ' ' << buf.RBW << ' ' << buf.WBW;
+}
+
+
 Core::Core(numMac_t _mac_num, numMac_t _LR_mac_num, energy_t _LR_mac_cost):
 	mac_num(_mac_num), LR_mac_num(_LR_mac_num), LR_mac_cost(_LR_mac_cost){}
 
+void Core::print_config(std::ostream& os) const{
+	os << "mac " << mac_num << " lr_mac " << LR_mac_num << ' ' << LR_mac_cost;
+}
+
 PolarCore::PolarCore(const PESetting& _pes, numMac_t _LR_mac_num, energy_t _LR_mac_cost,
 					 const Bus& _noc, const Buffers& _bufs):
 	Core(_noc.aLen * _noc.oLen * _pes.laneNum * _pes.vecSize, _LR_mac_num, _LR_mac_cost),
@@ -22,6 +31,15 @@ const Core::Buffer& PolarCore::ubuf() const{
 	return ul3;
 }
 
+void PolarCore::print_config(std::ostream& os) const{
+	os << "polar ";
+	Core::print_config(os);
+	os << " pe " << static_cast<int>(pes.vecSize) << ' ' << static_cast<int>(pes.laneNum) << ' ' << pes.MACCost;
+	os << " bus " << static_cast<int>(bus.aLen) << ' ' << static_cast<int>(bus.oLen) << ' ' << bus.hopCost << ' ' << bus.busBW;
+	os << " al1 " << al1 << " wl1 " << wl1 << " ol1 " << ol1;
+	os << " al2 " << al2 << " wl2 " << wl2 << " ol2 " << ol2 << " ul3 " << ul3;
+}
+
 PolarCore::PESetting::PESetting(vmac_t _vecSize, vmac_t _laneNum, energy_t _macCost):
 	vecSize(_vecSize),laneNum(_laneNum),MACCost(_macCost){}
 
@@ -43,6 +61,16 @@ const Core::Buffer& EyerissCore::ubuf() const{
 	return ul2;
 }
 
+void EyerissCore::print_config(std::ostream& os) const{
+	os << "eyeriss ";
+	Core::print_config(os);
+	os << " pe " << static_cast<int>(pes.Xarray) << ' ' << static_cast<int>(pes.Yarray) << ' ' << pes.MacCost;
+	os << " ibus " << ibus.BusCost << ' ' << ibus.BusBW;
+	os << " wbus " << wbus.BusCost << ' ' << wbus.BusBW;
+	os << " pbus " << pbus.BusCost << ' ' << pbus.BusBW;
+	os << " al1 " << al1 << " wl1 " << wl1 << " pl1 " << pl1 << " ul2 " << ul2;
+}
+
 EyerissCore::PESetting::PESetting(vmac_t _Xarray, vmac_t _Yarray, energy_t _MacCost) :
 	Xarray(_Xarray), Yarray(_Yarray), MacCost(_MacCost){}
 
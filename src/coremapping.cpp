@@ -1,7 +1,9 @@
 #include "coremapping.h"
 
 #include <cassert>
+#include <cmath>
 
+#include "layerdb.h"
 #include "partition.h"
 
 
@@ -31,7 +33,19 @@ const PolarInst::Part PolarInst::all_parts[]={
 
 // Codes for CoreMapper
 
-CoreMapper::CoreMapper(const Core& c):base_core(c){}
+CoreMapper::CoreMapper(const Core& c):base_core(c), db(nullptr){}
+
+void CoreMapper::set_db(LayerDB* _db){
+	db = _db;
+}
+
+Core::Buffer CoreMapper::elem_buffer(const Core::Buffer& buf, bwidth_t bits){
+	Core::Buffer res = buf;
+	res.Size = buf.Size * 8 / bits;
+	res.RCost *= bits / 8.0;
+	res.WCost *= bits / 8.0;
+	return res;
+}
 
 const Core& CoreMapper::core() const{
 	return base_core;
@@ -42,7 +56,19 @@ vol_t CoreMapper::get_ubuf_size() const{
 }
 
 void CoreMapper::set_utime(Layer& l) const{
-	if(REF_IS_INSTANCE(l, ConvLayer)){
+	if(REF_IS_INSTANCE(l, FusedLayer)){
+		// Post layers are overlapped with the base layer (see genTileMap).
+		const FusedLayer& fl = static_cast<const FusedLayer&>(l);
+		Layer& base = const_cast<Layer&>(fl.get_base());
+		set_utime(base);
+		utime_t t = base.get_utime();
+		for(const auto& post : fl.get_posts()){
+			Layer& p = const_cast<LRLayer&>(*post);
+			set_utime(p);
+			t = MAX(t, p.get_utime());
+		}
+		l.set_utime(t);
+	}else if(REF_IS_INSTANCE(l, ConvLayer)){
 		set_conv_utime(static_cast<ConvLayer&>(l));
 	}else{
 		set_lr_utime(static_cast<LRLayer&>(l));
@@ -72,7 +98,13 @@ PolarMapper::PolarMapper(const PolarCore& _core)
 
 void PolarMapper::set_conv_utime(ConvLayer& l) const{
 	utime_t t;
-	if(REF_IS_INSTANCE(l, GroupConvLayer)){
+	if(REF_IS_INSTANCE(l, GroupConvLayer) && static_cast<GroupConvLayer&>(l).get_workload().GC == 1){
+		// Depthwise: channels on lanes, R*S on vectors (see PolarInst::genDepthwise).
+		const GroupConvLayer::Workload& gwl = static_cast<GroupConvLayer&>(l).get_workload();
+		t = DIVCEIL(gwl.K, core.pes.laneNum) * core.pes.laneNum;
+		t *= DIVCEIL(gwl.R * gwl.S, core.pes.vecSize) * core.pes.vecSize;
+		t *= gwl.H * gwl.W;
+	}else if(REF_IS_INSTANCE(l, GroupConvLayer)){
 		GroupConvLayer::Workload gwl = static_cast<GroupConvLayer&>(l).get_workload();
 		gwl.C = DIVCEIL(gwl.GC, core.pes.vecSize)*core.pes.vecSize;
 		gwl.K = DIVCEIL(gwl.GK, core.pes.laneNum)*core.pes.laneNum;
@@ -95,7 +127,22 @@ void PolarMapper::set_conv_utime(ConvLayer& l) const{
 }
 
 CoreMapper::CoreMapping PolarMapper::genMapping(const ConvWl& wl){
-	PolarInst instance(core);
+	if(wl.ifm_bits == 8 && wl.wgt_bits == 8) return genMapping(core, wl);
+	// ol1/ol2 keep partial sums, whose width doesn't depend on the operands.
+	PolarCore::Buffers bufs = {
+		elem_buffer(core.al1, wl.ifm_bits), elem_buffer(core.wl1, wl.wgt_bits), core.ol1,
+		elem_buffer(core.al2, wl.ifm_bits), elem_buffer(core.wl2, wl.wgt_bits), core.ol2, core.ul3
+	};
+	return genMapping(PolarCore(core.pes, core.LR_mac_num, core.LR_mac_cost, core.bus, bufs), wl);
+}
+
+CoreMapper::CoreMapping PolarMapper::genMapping(const PolarCore& c, const ConvWl& wl){
+	PolarInst instance(c);
+	// The closed-form depthwise mapping bounds the tiling search,
+	// thus partitions that can't beat it are skipped.
+	if(wl.is_depthwise()){
+		return instance.genMapping(wl, instance.genDepthwise(wl));
+	}
 	return instance.genMapping(wl);
 }
 
@@ -106,22 +153,134 @@ EyerissMapper::EyerissMapper(const EyerissCore& _core)
 	: CoreMapper(_core), core(_core) {}
 
 CoreMapper::CoreMapping EyerissMapper::genMapping(const ConvWl& wl){
-	EyerissInst instance(core);
-	return instance.genMapping(wl);
+	if(wl.ifm_bits == 8 && wl.wgt_bits == 8) return genMapping(core, wl);
+	// pl1 keeps partial sums, whose width doesn't depend on the operands.
+	EyerissCore::Buffers bufs = {
+		elem_buffer(core.al1, wl.ifm_bits), elem_buffer(core.wl1, wl.wgt_bits), core.pl1, core.ul2
+	};
+	return genMapping(EyerissCore(core.pes, core.LR_mac_num, core.LR_mac_cost, {core.ibus, core.wbus, core.pbus}, bufs), wl);
+}
+
+CoreMapper::CoreMapping EyerissMapper::genMapping(const EyerissCore& c, const ConvWl& wl){
+	EyerissInst instance(c);
+	CoreMapping best = instance.genMapping(wl);
+	// The closed-form depthwise mapping is kept only if it beats the tiling search,
+	// which only tries a few replications for depthwise workloads (C = K = 1).
+	if(wl.is_depthwise()){
+		CoreMapping m = instance.genDepthwise(wl);
+		if(m.cost.is_valid() && m.cost.cost() < best.cost.cost()) best = m;
+	}
+	return best;
+}
+
+
+// Codes for RooflineMapper
+
+RooflineMapper::RooflineMapper(const Core& c)
+	:CoreMapper(c), vec_c(1), vec_k(1){
+	if(REF_IS_INSTANCE(c, PolarCore)){
+		const PolarCore& pc = static_cast<const PolarCore&>(c);
+		mac_cost = pc.pes.MACCost;
+		vec_c = pc.pes.vecSize;
+		vec_k = pc.pes.laneNum;
+	}else if(REF_IS_INSTANCE(c, EyerissCore)){
+		// The PE array is mapped on R and H, thus C/K are not padded.
+		mac_cost = static_cast<const EyerissCore&>(c).pes.MacCost;
+	}else{
+		assert(false);
+		mac_cost = 0;
+	}
+}
+
+CoreMapper::CoreMapping RooflineMapper::genMapping(const ConvWl& wl){
+	cycle_t comp_time;
+	if(wl.is_depthwise()){
+		// Channels of all groups on lanes, R*S on vectors (as in PolarMapper).
+		access_t pad_op = DIVCEIL(wl.nGroup * wl.K, vec_k) * vec_k;
+		pad_op *= DIVCEIL(wl.R * wl.S, vec_c) * vec_c;
+		pad_op *= wl.H * wl.W * wl.B;
+		comp_time = DIVCEIL(pad_op, base_core.mac_num);
+	}else{
+		// Groups are duplicated in the MAC array if C and K are small (as in PolarMapper).
+		len_t nDup = 1;
+		if(wl.nGroup > 1 && wl.C < vec_c && wl.K < vec_k){
+			nDup = MIN(MIN(vec_c / wl.C, vec_k / wl.K), wl.nGroup);
+		}
+		access_t pad_op = (wl.tot_op / wl.C / wl.K) * (DIVCEIL(wl.C, vec_c) * vec_c) * (DIVCEIL(wl.K, vec_k) * vec_k);
+		comp_time = DIVCEIL(pad_op, base_core.mac_num) * DIVCEIL(wl.nGroup, nDup);
+	}
+
+	const Core::Buffer& ubuf = base_core.ubuf();
+	vol_t ifmSize = wl.ifm_size(), filSize = wl.fil_size(), ofmSize = wl.ofm_size();
+	cycle_t read_time = DIVCEIL((ifmSize + filSize) * wl.nGroup, ubuf.RBW);
+
+	CoreMapping m;
+	m.mac = wl.tot_op * mac_cost * wl.nGroup;
+	m.ubuf = ((ifmSize + filSize) * ubuf.RCost + ofmSize * ubuf.WCost) * wl.nGroup;
+	m.buffer = m.noc = 0;
+	m.cost.energy = m.mac + m.ubuf;
+	m.cost.time = MAX(wl.mac_time(comp_time), read_time);
+	m.tot_util = wl.tot_op * wl.nGroup * wl.density;
+	m.tot_util /= (m.cost.time * base_core.mac_num);
+	m.util = m.tot_util;
+	return m;
 }
 
 
 // Codes for main search:
 
-CoreMapper::CoreMapping CoreMapper::genLayerMap(const Layer& layer, const PartSch& part, len_t batch_size, bool wgtB){
-	if(REF_IS_INSTANCE(layer, ConvLayer)){
+CoreMapper::CoreMapping CoreMapper::genLayerMap(const Layer& layer, const PartSch& part, len_t batch_size, bool wgtB, double mac_scale, bwidth_t ifm_bits, bwidth_t wgt_bits){
+	const fmap_shape& ofm = layer.ofmap_shape();
+	fmap_shape tile(DIVCEIL(ofm.c, part.K), DIVCEIL(ofm.h, part.H), DIVCEIL(ofm.w, part.W));
+	return genTileMap(layer, tile, DIVCEIL(batch_size, part.B), wgtB, mac_scale, ifm_bits, wgt_bits);
+}
+
+CoreMapper::CoreMapping CoreMapper::genTileMap(const Layer& layer, const fmap_shape& tile, len_t B, bool wgtB, double mac_scale, bwidth_t ifm_bits, bwidth_t wgt_bits){
+	if(REF_IS_INSTANCE(layer, FusedLayer)){
+		// Fused Layer...
+		// Each post layer maps the ofmap tile of the layer before it (with halos of pooling),
+		// and runs on the LR units while the MACs compute the next tile.
+		const FusedLayer& fl = static_cast<const FusedLayer&>(layer);
+		const auto& posts = fl.get_posts();
+		fmap_range range(tile);
+		CoreMapping postMap;
+		postMap.cost.energy = 0;
+		postMap.cost.time = 0;
+		for(std::size_t i = posts.size(); i-- > 0;){
+			// Only scaled by the bitwidth of its ifmap (the ofmap of the layer before it).
+			const Layer& in = (i == 0) ? fl.get_base() : *posts[i-1];
+			CoreMapping cur = genTileMap(*posts[i], fmap_shape(range.c.size(), range.h.size(), range.w.size()), B, false, in.get_bitwidth() / 8.0, in.get_bitwidth(), wgt_bits);
+			postMap.cost.energy += cur.cost.energy;
+			postMap.cost.time = MAX(postMap.cost.time, cur.cost.time);
+			posts[i]->ofm_to_ifm(range);
+		}
+
+		CoreMapping m = genTileMap(fl.get_base(), fmap_shape(range.c.size(), range.h.size(), range.w.size()), B, wgtB, mac_scale, ifm_bits, wgt_bits);
+		if(!m.cost.is_valid()) return m;
+		m.cost.energy += postMap.cost.energy;
+		m.mac += postMap.cost.energy;
+		if(postMap.cost.time > m.cost.time){
+			double ratio = static_cast<double>(m.cost.time) / postMap.cost.time;
+			m.util *= ratio;
+			m.tot_util *= ratio;
+			m.cost.time = postMap.cost.time;
+		}
+		return m;
+	}else if(REF_IS_INSTANCE(layer, ConvLayer)){
 		// Conv Layer...
 		const ConvLayer& cl=static_cast<const ConvLayer&>(layer);
-		ConvWl wl(cl.get_workload(), DIVCEIL(batch_size, part.B));
-		wl.K = DIVCEIL(wl.K, part.K);
-		wl.H = DIVCEIL(wl.H, part.H);
-		wl.W = DIVCEIL(wl.W, part.W);
-		if(REF_IS_INSTANCE(layer, GroupConvLayer)){
+		ConvWl wl(cl.get_workload(), B);
+		wl.K = tile.c;
+		wl.H = tile.h;
+		wl.W = tile.w;
+		if(REF_IS_INSTANCE(layer, MatMulLayer)){
+			// Groups in the K part, with columns split evenly among them
+			// (instead of padding each group to N).
+			const auto& mmWl = static_cast<const MatMulLayer&>(cl).get_workload();
+			wl.nGroup = DIVCEIL(wl.K, mmWl.N);
+			wl.C = mmWl.L;
+			wl.K = DIVCEIL(wl.K, wl.nGroup);
+		}else if(REF_IS_INSTANCE(layer, GroupConvLayer)){
 			const GroupConvLayer& gcl=static_cast<const GroupConvLayer&>(cl);
 			const auto& gclWl = gcl.get_workload();
 			wl.nGroup = DIVCEIL(wl.K, gclWl.GK);
@@ -133,19 +292,42 @@ CoreMapper::CoreMapping CoreMapper::genLayerMap(const Layer& layer, const PartSc
 			wl.nGroup *= wl.B;
 			wl.B = 1;
 		}
+		// Zero weights are skipped (weights of fmaps are dense).
+		if(layer.weight_size() > 0 && !wgtB){
+			wl.density = layer.get_sparsity().get_density();
+		}
+		wl.ifm_bits = ifm_bits;
+		wl.wgt_bits = wgt_bits;
 		wl.calc_op();
-		return genMapping(wl);
+		if(db == nullptr) return genMapping(wl).scale_mac(mac_scale);
+
+		// The mapping only depends on the workload.
+		LayerDB::key_t key;
+		for(len_t x : {wl.C, wl.K, wl.R, wl.S, wl.H, wl.W, wl.sH, wl.sW, wl.B, wl.nGroup}){
+			LayerDB::add_key(key, x);
+		}
+		// Kept out of the key when dense, thus old DB files stay valid.
+		if(wl.density != 1) LayerDB::add_key(key, wl.density);
+		if(wl.ifm_bits != 8 || wl.wgt_bits != 8){
+			LayerDB::add_key(key, static_cast<len_t>(wl.ifm_bits));
+			LayerDB::add_key(key, static_cast<len_t>(wl.wgt_bits));
+		}
+		CoreMapping mapping;
+		if(!db->find_mapping(key, mapping)){
+			mapping = genMapping(wl);
+			db->add_mapping(key, mapping);
+		}
+		return mapping.scale_mac(mac_scale);
 	}else if(REF_IS_INSTANCE(layer, LRLayer)){
 		assert(!wgtB);
 		// LR Layer...
 		const LRLayer& lrl=static_cast<const LRLayer&>(layer);
 		LRLayer::Workload wl = lrl.get_workload();
-		batch_size = DIVCEIL(batch_size, part.B);
-		wl.K = DIVCEIL(wl.K, part.K);
-		wl.H = DIVCEIL(wl.H, part.H);
-		wl.W = DIVCEIL(wl.W, part.W);
+		wl.K = tile.c;
+		wl.H = tile.h;
+		wl.W = tile.w;
 		wl.update_op();
-		access_t tot_op = wl.calc_op(batch_size);
+		access_t tot_op = wl.calc_op(B);
 
 		CoreMapping m;
 		m.cost.energy = tot_op * base_core.LR_mac_cost;
@@ -155,7 +337,7 @@ CoreMapper::CoreMapping CoreMapper::genLayerMap(const Layer& layer, const PartSc
 		m.util = tot_op;
 		m.util /= (m.cost.time * base_core.LR_mac_num);
 		m.tot_util = m.util;
-		return m;
+		return m.scale_mac(mac_scale);
 	}else{
 		assert(false);
 		return CoreMapping();
@@ -226,8 +408,8 @@ PolarInst::Instance(const PolarCore& _core):core(_core){
 	W_NB.BSD.cnt = -1;
 }
 
-CoreMapper::CoreMapping PolarInst::genMapping(const CoreMapper::ConvWl& wl){
-	best_map = CoreMapping();
+CoreMapper::CoreMapping PolarInst::genMapping(const CoreMapper::ConvWl& wl, const CoreMapper::CoreMapping& init){
+	best_map = init;
 
 	// For later.
 	len_t tot_ifmW = (wl.W-1) * wl.sW + wl.S;
@@ -291,6 +473,28 @@ CoreMapper::CoreMapping PolarInst::genMapping(const CoreMapper::ConvWl& wl){
 		tot_op_k = (wl.tot_op/wl.K)*totTK*pnum_k;
 		tot_op_c = (wl.tot_op/wl.C)*totTC*pnum_c;
 
+		/*
+		 * Lower bound of all tilings of this partition (see getCost):
+		 * comp_time, MAC energy, and accesses which don't depend on tiling
+		 * (OL1, OL2, ofmap written to UL3, and filter read from UL3 at least once).
+		 * If the bound is not better than best_map, the whole W1/H1 sweep is skipped.
+		 */
+		if(best_map.cost.is_valid()){
+			energy_t min_energy = wl.tot_op * core.pes.MACCost
+					+ (tot_op_c + pnum_c*ofmSize) * core.ol1.RCost
+					+ tot_op_c * core.ol1.WCost
+					+ ofmSize * (core.ol2.RCost + core.ol2.WCost)
+					+ ofmSize * core.ul3.WCost
+					+ filSize * core.ul3.RCost;
+			cycle_t min_time = wl.mac_time(comp_time);
+			if(wl.nGroup > 1){
+				min_energy *= wl.nGroup;
+				min_time *= TGroup;
+			}
+			// Leaves a margin for rounding errors, thus best_map is never changed by skipping.
+			if(MapCost(min_energy * (1 - 1e-9), min_time).cost() >= best_map.cost.cost()) continue;
+		}
+
 		// Calculate L1 size:
 		/* AL1: H'1*W'1*(C?)
 		 * WL1: R*S*(C?)*K1 (8 WL1 in total)
@@ -523,6 +727,79 @@ CoreMapper::CoreMapping PolarInst::genMapping(const CoreMapper::ConvWl& wl){
 	return best_map;
 }
 
+/*
+ * Polar Depthwise Dataflow
+ *
+ * In a depthwise workload each ofmap channel only reads one ifmap channel,
+ * thus the generic dataflow (C on vectors, K on lanes) uses one lane and
+ * one vector element per group. Instead, channels of all groups are packed
+ * on lanes, and the R*S taps of each channel are reduced on vectors:
+ *
+ * // PE level: channel tiles first, then B*H*W
+ * for Ch / (laneNum * PEs on channels)
+ *   for BHW / (PEs on BHW)
+ *     for RS / vecSize
+ *       // laneNum channels, vecSize taps
+ *
+ * Each PE keeps the filters of its channels in WL1, and the ifmap rows of
+ * the current window in AL1 (each datum is written once, full reuse),
+ * thus the tiling is closed-form and needs no search.
+ */
+CoreMapper::CoreMapping PolarInst::genDepthwise(const CoreMapper::ConvWl& wl){
+	const len_t vecT = DIVCEIL(wl.R * wl.S, core.pes.vecSize);
+	// L1 should at least hold the filters and one window of laneNum channels.
+	if(core.wl1.Size < static_cast<vol_t>(vecT) * core.pes.vecSize * core.pes.laneNum ||
+	   core.al1.Size < static_cast<vol_t>(wl.R) * wl.S * core.pes.laneNum ||
+	   core.ol1.Size < core.pes.laneNum){
+		return CoreMapping();
+	}
+
+	const len_t numPE = core.bus.aLen * core.bus.oLen;
+	const len_t chTiles = DIVCEIL(wl.nGroup * wl.K, core.pes.laneNum);
+	const len_t chPE = MIN(chTiles, numPE);
+	const len_t bhwPE = numPE / chPE;
+	const vol_t bhw = static_cast<vol_t>(wl.B) * wl.H * wl.W;
+	const cycle_t comp_time = static_cast<cycle_t>(DIVCEIL(chTiles, chPE)) * vecT * DIVCEIL(bhw, bhwPE);
+
+	const access_t tot_op = wl.tot_op * wl.nGroup;
+	const vol_t ifmSize = wl.ifm_size() * wl.nGroup;
+	const vol_t filSize = wl.fil_size() * wl.nGroup;
+	const vol_t ofmSize = wl.ofm_size() * wl.nGroup;
+	// Partial sums of each vector op.
+	const access_t vec_op = ofmSize * vecT;
+
+	access_t al1Read = tot_op;
+	access_t al1Write = ifmSize * wl.K;
+	access_t wl1Read = tot_op;
+	access_t wl1Write = filSize * bhwPE;
+	access_t ol1Write = vec_op;
+	access_t ol1Read = vec_op + ofmSize;
+	access_t ol2Read = ofmSize;
+	access_t ol2Write = ofmSize;
+	access_t ul3Read = ifmSize + filSize;
+	access_t ul3Write = ofmSize;
+
+	CoreMapping m;
+	m.buffer = al1Read * core.al1.RCost
+			+ al1Write * core.al1.WCost
+			+ wl1Read * core.wl1.RCost
+			+ wl1Write * core.wl1.WCost
+			+ ol1Read * core.ol1.RCost
+			+ ol1Write * core.ol1.WCost
+			+ ol2Read * core.ol2.RCost
+			+ ol2Write * core.ol2.WCost;
+	m.ubuf = ul3Read * core.ul3.RCost
+			+ ul3Write * core.ul3.WCost;
+	m.noc = 0;
+	m.mac = tot_op * core.pes.MACCost;
+	m.cost.energy = m.ubuf + m.buffer + m.noc + m.mac;
+	m.cost.time = MAX(wl.mac_time(comp_time), DIVCEIL(ul3Read, core.ul3.RBW));
+	m.util = static_cast<double>(tot_op) / (comp_time * core.mac_num);
+	assert(m.util <= 1 + 1e-6);
+	m.tot_util = tot_op * wl.density / (m.cost.time * core.mac_num);
+	return m;
+}
+
 void PolarInst::getCost(const ConvWl& wl){
 	// (X)L2D Loop: The first relevant (to X) loop above L1/BSD
 	// (X)L2T Loop: The first relevant (to X) loop above L2
@@ -698,7 +975,7 @@ void PolarInst::getCost(const ConvWl& wl){
 		}
 	}
 
-	cycle_t tot_time = comp_time;
+	cycle_t tot_time = wl.mac_time(comp_time);
 	cycle_t ul3_rtime = DIVCEIL(ul3Read * nDup,core.ul3.RBW);
 	tot_time = MAX(tot_time, ul3_rtime);
 	if(hasAL2){
@@ -726,7 +1003,8 @@ void PolarInst::getCost(const ConvWl& wl){
 	double tot_op = wl.tot_op * wl.nGroup;
 	double util = tot_op / (comp_time * TGroup * core.mac_num);
 	assert(util <= 1 + 1e-6);
-	double tot_util = tot_op / (tot_time * core.mac_num);
+	// Skipped MACs (zero weights) are not counted.
+	double tot_util = tot_op * wl.density / (tot_time * core.mac_num);
 
 	MapCost cost(tot_energy, tot_time);
 	if(cost.cost() < best_map.cost.cost()){
@@ -897,6 +1175,75 @@ CoreMapper::CoreMapping EyerissInst::genMapping(const CoreMapper::ConvWl& wl) {
 	return best_map;
 }
 
+/*
+ * Eyeriss Depthwise Dataflow
+ *
+ * With C = K = 1 in each group, the generic dataflow can only replicate
+ * the R*PW physical array over batches, and maps groups one by one.
+ * Instead, channels of all groups are replicated like K:
+ * Yarray/R copies in height, and Xarray/H copies in width (if H < Xarray).
+ *
+ * for (Ch*B*foldW) / #copies
+ *   for W
+ *     for S
+ *
+ * Each filter is loaded once into its copy (PW PEs), and the ifmap of each
+ * channel is read once from UL2, thus the tiling is closed-form.
+ */
+CoreMapper::CoreMapping EyerissInst::genDepthwise(const CoreMapper::ConvWl& wl){
+	if(core.al1.Size < wl.S || core.wl1.Size < wl.S || core.pes.Yarray < wl.R){
+		return CoreMapping();
+	}
+
+	tot_ifmW = (wl.W - 1) * wl.sW + wl.S;
+	fold_t fold_w = DIVCEIL(wl.H, core.pes.Xarray);
+	phyarr_w = static_cast<vmac_t>(DIVCEIL(wl.H, fold_w));
+	const reply_t copies = (core.pes.Yarray / wl.R) * MAX(core.pes.Xarray / wl.H, 1);
+
+	const len_t channels = wl.nGroup * wl.K;
+	const access_t items = static_cast<access_t>(channels) * wl.B * fold_w;
+	const cycle_t comp_time = static_cast<cycle_t>(wl.W) * wl.S * DIVCEIL(items, copies);
+
+	const access_t tot_op = wl.tot_op * wl.nGroup;
+	ifmSize = wl.ifm_size() * wl.nGroup;
+	filSize = wl.fil_size() * wl.nGroup;
+	ofmSize = wl.ofm_size() * wl.nGroup;
+
+	access_t ul2_ar = ifmSize * wl.K;
+	access_t ul2_wr = filSize;
+	access_t ul2_pr = ofmSize, ul2_pw = ofmSize;
+	access_t bus_aw = ul2_ar, bus_ww = ul2_wr, bus_pw = ul2_pr + ul2_pw - ofmSize;
+
+	access_t al1_r = tot_op, wl1_r = tot_op;
+	access_t pl1_r = tot_op - ofmSize, pl1_w = tot_op - ofmSize;
+	access_t wl1_w = filSize * phyarr_w;
+	access_t al1_w = static_cast<access_t>(wl.R) * wl.H * tot_ifmW * wl.B * channels;
+
+	CoreMapping m;
+	m.buffer = al1_w * core.al1.WCost
+			+ wl1_w * core.wl1.WCost
+			+ pl1_w * core.pl1.WCost
+			+ al1_r * core.al1.RCost
+			+ wl1_r * core.wl1.RCost
+			+ pl1_r * core.pl1.RCost;
+	m.ubuf = (ul2_ar + ul2_wr + ul2_pr) * core.ul2.RCost
+			+ ul2_pw * core.ul2.WCost;
+	m.noc = bus_aw * core.ibus.BusCost
+			+ bus_ww * core.wbus.BusCost
+			+ bus_pw * core.pbus.BusCost;
+	m.mac = tot_op * core.pes.MacCost;
+	m.cost.energy = m.ubuf + m.buffer + m.noc + m.mac;
+
+	cycle_t tot_time = DIVCEIL(bus_aw, core.ibus.BusBW);
+	tot_time = MAX(tot_time, DIVCEIL(bus_ww, core.wbus.BusBW));
+	tot_time = MAX(tot_time, DIVCEIL(bus_pw, core.pbus.BusBW));
+	m.cost.time = MAX(tot_time, wl.mac_time(comp_time));
+	m.util = static_cast<double>(tot_op) / (comp_time * core.mac_num);
+	assert(m.util <= 1 + 1e-6);
+	m.tot_util = tot_op * wl.density / (m.cost.time * core.mac_num);
+	return m;
+}
+
 void EyerissInst::getCost(const CoreMapper::ConvWl& wl) {
 	access_t al1_r, al1_w, wl1_r, wl1_w, pl1_r, pl1_w, ul2_r, ul2_w; // ul2_w will be calculated out of intra-core cost.
 	access_t ul2_ar, ul2_aw, ul2_wr, ul2_ww, ul2_pr, ul2_pw;
@@ -960,13 +1307,13 @@ void EyerissInst::getCost(const CoreMapper::ConvWl& wl) {
 	cycle_t tot_time;
 	tot_time = MAX(d_ibus, d_pbus);
 	tot_time = MAX(tot_time, d_wbus);
-	tot_time = MAX(tot_time, comp_time);
+	tot_time = MAX(tot_time, wl.mac_time(comp_time));
 
 	double util = wl.tot_op * 1.0 / (comp_time * core.mac_num);
 	// std::cout << util << ' ' << Kt << ' ' << Ct << ' ' << Bt << std::endl;
 	// std::cout << ' ' << wl.K << ' ' << wl.C << ' ' << wl.B << ' ' << wl.H << std::endl;
 	assert(util <= 1 + 1e-6);
-	double tot_util = wl.tot_op * 1.0 / (tot_time * core.mac_num);
+	double tot_util = wl.tot_op * wl.density / (tot_time * core.mac_num);
 	MapCost cost(tot_energy, tot_time);
 	// std::cout << "cost.time = " << cost.time << "ul2_ar.energy" << ul2_ar/cost.energy << "tot_util=" << tot_util << "\n";
 	if(cost.cost() < best_map.cost.cost()){
@@ -978,7 +1325,7 @@ void EyerissInst::getCost(const CoreMapper::ConvWl& wl) {
 // Codes for CoreMapper::ConvWl
 
 CoreMapper::ConvWl::ConvWl(const CoreMapper::ConvParent& parent, len_t _B)
-	:ConvParent (parent), B(_B), nGroup(1){}
+	:ConvParent (parent), B(_B), nGroup(1), density(1), ifm_bits(8), wgt_bits(8){}
 
 void CoreMapper::ConvWl::init(){
 	ConvParent::init();
@@ -998,6 +1345,15 @@ void CoreMapper::ConvWl::calc_op(){
 	tot_op *= B;
 }
 
+bool CoreMapper::ConvWl::is_depthwise() const{
+	return nGroup > 1 && C == 1;
+}
+
+cycle_t CoreMapper::ConvWl::mac_time(cycle_t comp_time) const{
+	if(density == 1) return comp_time;
+	return static_cast<cycle_t>(std::ceil(comp_time * density));
+}
+
 // Codes for CoreMapper::MapCost
 
 CoreMapper::MapCost::MapCost(energy_t _energy, cycle_t _time)
@@ -1025,6 +1381,13 @@ CoreMapper::CoreMapping& CoreMapper::CoreMapping::operator*=(len_t factor){
 	return *this;
 }
 
+CoreMapper::CoreMapping& CoreMapper::CoreMapping::scale_mac(double factor){
+	if(cost.energy == energy_inf || factor == 1) return *this;
+	cost.energy += mac * (factor - 1);
+	mac *= factor;
+	return *this;
+}
+
 CoreMapper::CoreMapping& CoreMapper::CoreMapping::operator+=(const CoreMapping& other){
 	if(cost.energy == energy_inf || other.cost.energy == energy_inf){
 		cost.energy = energy_inf;
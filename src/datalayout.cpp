@@ -7,12 +7,12 @@
 
 
 void DataLayout::update(const fmap_range& range){
-	vol_t s = range.size();
+	vol_t s = dataVol(range.size());
 	totVolume += s * bcastLength();
 	maxVolume = MAX(maxVolume, s);
 }
 
-DataLayout::DataLayout():totVolume(0), maxVolume(0), multFactor(1){}
+DataLayout::DataLayout():totVolume(0), maxVolume(0), multFactor(1), bitwidth(8){}
 
 vol_t DataLayout::totalSize() const{
 	return totVolume;
@@ -22,6 +22,24 @@ vol_t DataLayout::maxRange() const{
 	return maxVolume;
 }
 
+void DataLayout::setBitwidth(bwidth_t width){
+	bitwidth = width;
+}
+
+bwidth_t DataLayout::getBitwidth() const{
+	return bitwidth;
+}
+
+void DataLayout::setSparsity(const Sparsity& sp){
+	sparsity = sp;
+}
+
+vol_t DataLayout::dataVol(vol_t num) const{
+	if(!sparsity.is_dense()) return DIVCEIL(sparsity.bits(num, bitwidth), 8);
+	if(bitwidth == 8) return num;
+	return DIVCEIL(num * bitwidth, 8);
+}
+
 void DataLayout::sizeMult(len_t num){
 	multFactor *= num;
 	totVolume *= num;
@@ -37,7 +55,7 @@ bool DataLayout::update(BufferUsage& usage) const{
 	dataLen_t totL = totLength();
 	for(dataLen_t i = 0; i < totL; ++i){
 		UniqueEntry ent = (*this)[i];
-		vol_t s = ent.range.size();
+		vol_t s = dataVol(ent.range.size());
 		if(s == 0) continue;
 		s *= multFactor;
 		if(!usage.add(ent.tile, s)) return false;
@@ -79,6 +97,8 @@ StdDataLayout::StdDataLayout(dataLen_t _len, pos_t* _posArr)
 
 DataLayout* StdDataLayout::clone() const{
 	StdDataLayout* newLayout = new StdDataLayout(tot_len, nullptr);
+	newLayout->bitwidth = bitwidth;
+	newLayout->sparsity = sparsity;
 
 	if(tot_len <= 0) return newLayout;
 
@@ -171,6 +191,8 @@ StdULayout::StdULayout(dataLen_t _len, pos_t* _posArr)
 
 UniqueLayout* StdULayout::clone() const{
 	StdULayout* newLayout = new StdULayout(len, nullptr);
+	newLayout->bitwidth = bitwidth;
+	newLayout->sparsity = sparsity;
 
 	if(len <= 0) return newLayout;
 
@@ -0,0 +1,236 @@
+#include "dp.h"
+
+#include <algorithm>	// std::sort, std::reverse
+#include <atomic>		// std::atomic
+#include <cassert>		// assert
+#include <iostream>		// std::cout, std::endl
+#include <stdexcept>	// std::invalid_argument
+#include <thread>		// std::thread
+
+#include "network.h"	// network
+#include "sa.h"			// WholeSch
+
+
+DPEngine::DPEngine(const Cluster& c, len_t _tot_batch, unsigned _num_threads, lid_t _max_len)
+	:cluster(c), tot_batch(_tot_batch), num_layer(network->len()),
+	  num_threads(MAX(_num_threads, 1U)), max_len(_max_len > 0 ? _max_len : network->len()){}
+
+DPEngine::~DPEngine(){
+	for(auto& item : singles){
+		delete item.second.first;
+		delete item.second.second;
+	}
+}
+
+DPEngine::seg_key DPEngine::key(const Segment& seg){
+	return seg_key(seg.from, seg.to, seg.type, seg.top, seg.batch);
+}
+
+void DPEngine::add_singles(std::vector<Segment>& segs, lid_t from, lid_t to, len_t top){
+	for(lid_t i = from; i < to; ++i){
+		segs.push_back({i, i, LTreeNode::NodeType::L, top, top});
+	}
+}
+
+LTreeNode* DPEngine::build_tree(const std::vector<Segment>& segs) const{
+	LTreeNode* root = new LTreeNode(Bitset(), tot_batch, nullptr, LTreeNode::NodeType::T);
+	for(const Segment& seg : segs){
+		if(seg.type == LTreeNode::NodeType::L){
+			assert(seg.from == seg.to);
+			(void) new LTreeNode(seg.from, seg.top, root);
+			continue;
+		}
+		LTreeNode* cut = new LTreeNode(Bitset(), seg.top, root, seg.type);
+		for(lid_t i = seg.from; i <= seg.to; ++i){
+			(void) new LTreeNode(i, seg.batch, cut);
+		}
+	}
+	root->init_root();
+	return root;
+}
+
+SchNode::SchCost DPEngine::eval(const Segment& seg) const{
+	std::vector<Segment> segs;
+	add_singles(segs, 0, seg.from, seg.top);
+	segs.push_back(seg);
+	add_singles(segs, seg.to + 1, num_layer, seg.top);
+	LTreeNode* tree = build_tree(segs);
+
+	SchNode::SchCost cost;
+	if(SchNode::quick_check(tree, cluster)){
+		// Single layers are the same as in singles, only "seg" is searched.
+		SchNode::setReuse(singles.at(seg.top).second);
+		SchNode* sch = SchNode::newNode(tree, cluster, nullptr);
+		SchNode::setReuse(nullptr);
+
+		// The segment is the child at position seg.from.
+		const auto& children = static_cast<const Cut*>(sch)->getChildren();
+		if(children.size() > seg.from && children[seg.from]->is_valid()){
+			cost = children[seg.from]->get_cost();
+		}
+		delete sch;
+	}
+	delete tree;
+	return cost;
+}
+
+void DPEngine::eval_all(const std::vector<Segment>& segs){
+	std::vector<Segment> tasks;
+	for(const Segment& seg : segs){
+		if(seg_costs.find(key(seg)) != seg_costs.end()) continue;
+		tasks.push_back(seg);
+
+		if(singles.find(seg.top) == singles.end()){
+			std::vector<Segment> single_segs;
+			add_singles(single_segs, 0, num_layer, seg.top);
+			LTreeNode* tree = build_tree(single_segs);
+			SchNode* sch = SchNode::newNode(tree, cluster, nullptr);
+			if(!sch->is_valid()){
+				std::cout << "Warning: some layers are not valid alone with batch " << seg.top << ", DP may miss schemes." << std::endl;
+			}
+			singles[seg.top] = {tree, sch};
+		}
+	}
+
+	std::vector<SchNode::SchCost> costs(tasks.size());
+	std::atomic<std::size_t> next(0);
+	auto work = [&]{
+		std::size_t i;
+		while((i = next++) < tasks.size()){
+			costs[i] = eval(tasks[i]);
+		}
+	};
+	std::vector<std::thread> workers;
+	for(unsigned i = 1; i < MIN(num_threads, static_cast<unsigned>(tasks.size())); ++i){
+		workers.emplace_back(work);
+	}
+	work();
+	for(auto& thr : workers){
+		thr.join();
+	}
+
+	for(std::size_t i = 0; i < tasks.size(); ++i){
+		seg_costs[key(tasks[i])] = costs[i];
+	}
+}
+
+std::vector<DPEngine::Segment> DPEngine::segments_to(lid_t to, len_t top, bool has_S, bool has_T) const{
+	std::vector<Segment> segs;
+	lid_t first = (to + 1 > max_len) ? to + 1 - max_len : 0;
+	for(lid_t from = first; from < to; ++from){
+		// Batch sizes are top / 2^k, as in SAEngine::halv_bat().
+		for(len_t b = top; b > 0; b /= 2){
+			if(has_S) segs.push_back({from, to, LTreeNode::NodeType::S, top, b});
+			if(has_T) segs.push_back({from, to, LTreeNode::NodeType::T, top, b});
+			if(b % 2 != 0) break;
+		}
+	}
+	add_singles(segs, to, to + 1, top);
+	return segs;
+}
+
+std::vector<DPEngine::Segment> DPEngine::optimal_segments(len_t top, bool has_S, bool has_T, SchNode::SchCost& cost){
+	// fronts[i]: Pareto front of layers [0, i).
+	std::vector<std::vector<Label>> fronts(num_layer + 1);
+	fronts[0].push_back({SchNode::SchCost(0, 0), {0, 0, LTreeNode::NodeType::L, 0, 0}, 0});
+	for(lid_t to = 0; to < num_layer; ++to){
+		std::vector<Label> labels;
+		for(const Segment& seg : segments_to(to, top, has_S, has_T)){
+			const SchNode::SchCost& seg_cost = seg_costs.at(key(seg));
+			if(!seg_cost.isValid()) continue;
+			const auto& prev_front = fronts[seg.from];
+			for(std::size_t i = 0; i < prev_front.size(); ++i){
+				Label label = {prev_front[i].cost, seg, i};
+				label.cost += seg_cost;
+				labels.push_back(label);
+			}
+		}
+
+		// Keeps labels not dominated in both energy and time.
+		std::sort(labels.begin(), labels.end(), [](const Label& a, const Label& b){
+			if(a.cost.energy != b.cost.energy) return a.cost.energy < b.cost.energy;
+			return a.cost.time < b.cost.time;
+		});
+		auto& front = fronts[to + 1];
+		for(const Label& label : labels){
+			if(front.empty() || label.cost.time < front.back().cost.time){
+				front.push_back(label);
+			}
+		}
+	}
+
+	std::vector<Segment> segs;
+	const auto& last_front = fronts[num_layer];
+	if(last_front.empty()) return segs;
+
+	// Picks the best scheme (all segments are repeated tot_batch/top times), and traces back its segments.
+	len_t num_bgrp = tot_batch / top;
+	std::size_t best = 0;
+	for(std::size_t i = 1; i < last_front.size(); ++i){
+		if(last_front[i].cost.cost(num_bgrp) < last_front[best].cost.cost(num_bgrp)) best = i;
+	}
+	cost = last_front[best].cost;
+	cost *= num_bgrp;
+	for(lid_t to = num_layer; to > 0;){
+		const Label& label = fronts[to][best];
+		segs.push_back(label.seg);
+		best = label.prev;
+		to = label.seg.from;
+	}
+	std::reverse(segs.begin(), segs.end());
+	return segs;
+}
+
+void DPEngine::search(WholeSch& w_sch, bool has_S, bool has_T){
+	if(!has_S && !has_T){
+		throw std::invalid_argument("Either has_S or has_T must be true.");
+	}
+
+	// Schedules all segments first (in parallel).
+	std::vector<Segment> segs;
+	for(len_t top = tot_batch; top > 0; top /= 2){
+		for(lid_t to = 0; to < num_layer; ++to){
+			auto cur_segs = segments_to(to, top, has_S, has_T);
+			segs.insert(segs.end(), cur_segs.begin(), cur_segs.end());
+		}
+		if(top % 2 != 0) break;
+	}
+	eval_all(segs);
+
+	std::size_t num_valid = 0;
+	for(const Segment& seg : segs){
+		num_valid += seg_costs.at(key(seg)).isValid();
+	}
+	std::cout << "DP: " << segs.size() << " segments (" << num_valid << " valid)." << std::endl;
+
+	// DP for each batch size of segments.
+	std::vector<Segment> best_segs;
+	SchNode::SchCost best_cost;
+	for(len_t top = tot_batch; top > 0; top /= 2){
+		SchNode::SchCost cur_cost;
+		auto cur_segs = optimal_segments(top, has_S, has_T, cur_cost);
+		if(!cur_segs.empty() && cur_cost.cost() < best_cost.cost()){
+			best_segs = std::move(cur_segs);
+			best_cost = cur_cost;
+		}
+		if(top % 2 != 0) break;
+	}
+
+	w_sch = WholeSch();
+	if(best_segs.empty()){
+		std::cout << "Warning: no scheme found in DP!" << std::endl;
+		return;
+	}
+
+	LTreeNode* tree = build_tree(best_segs);
+	SchNode* sch = SchNode::newNode(tree, cluster, nullptr);
+	if(!sch->is_valid()){
+		// Should not happen, since segments are independent.
+		std::cout << "Warning: DP scheme is not valid!" << std::endl;
+		delete tree;
+		delete sch;
+		return;
+	}
+	tree->confirm();
+	w_sch = WholeSch(tree, sch);
+}
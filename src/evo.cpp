@@ -0,0 +1,208 @@
+#include "evo.h"
+
+#include <algorithm>	// std::stable_sort
+#include <atomic>		// std::atomic
+#include <ctime>		// std::time
+#include <iostream>		// std::cout, std::endl
+#include <set>			// std::set
+#include <thread>		// std::thread
+
+#include "network.h"	// network
+#include "schnode.h"	// SchNode
+#include "transtable.h"	// TransTable
+
+
+int EvoEngine::num_gens = 0;
+
+EvoEngine::EvoEngine(std::uint32_t seed, unsigned _num_threads)
+	:num_threads(MAX(_num_threads, 1U)), generator(seed), mutator(seed + 1){}
+
+int EvoEngine::randInt(int to){
+	return std::uniform_int_distribution(0, to-1)(generator);
+}
+
+bool EvoEngine::withProb(double prob){
+	return std::uniform_real_distribution(0.0, 1.0)(generator) < prob;
+}
+
+std::size_t EvoEngine::select(const std::vector<WholeSch>& pop){
+	// Since pop is sorted, the smallest index wins.
+	std::size_t best = pop.size();
+	for(int i = 0; i < tour_size; ++i){
+		best = MIN(best, static_cast<std::size_t>(randInt(static_cast<int>(pop.size()))));
+	}
+	return best;
+}
+
+void EvoEngine::collect(LTreeNode* node, LTreeNode::node_vec& nodes){
+	for(auto child : node->children){
+		nodes.push_back(child);
+		collect(child, nodes);
+	}
+}
+
+bool EvoEngine::same_tree(const LTreeNode* a, const LTreeNode* b){
+	if(a->t != b->t || a->num_batch != b->num_batch || !(a->layer_set == b->layer_set)) return false;
+	if(a->children.size() != b->children.size()) return false;
+	for(std::size_t i = 0; i < a->children.size(); ++i){
+		if(!same_tree(a->children[i], b->children[i])) return false;
+	}
+	return true;
+}
+
+bool EvoEngine::crossover(LTreeNode* tree, LTreeNode* other){
+	LTreeNode::node_vec nodes, other_nodes;
+	collect(tree, nodes);
+	collect(other, other_nodes);
+
+	// All pairs of exchangeable subtrees.
+	std::vector<std::pair<LTreeNode*, LTreeNode*>> pairs;
+	for(auto x : nodes){
+		if(x->t == LTreeNode::NodeType::L) continue;
+		for(auto y : other_nodes){
+			if(x->t == y->t && x->num_batch == y->num_batch && x->layer_set == y->layer_set && !same_tree(x, y)){
+				pairs.emplace_back(x, y);
+			}
+		}
+	}
+	if(pairs.empty()) return false;
+
+	auto& p = pairs[randInt(static_cast<int>(pairs.size()))];
+	LTreeNode* x = p.first;
+	LTreeNode* parent = x->parent;
+	LTreeNode* y = p.second->copy();
+	y->parent = parent;
+	for(auto& child : parent->children){
+		if(child == x){
+			child = y;
+			break;
+		}
+	}
+	delete x;
+	// Stages in "parent" will be re-calculated.
+	parent->stage.clear();
+	tree->init_root();
+	return true;
+}
+
+void EvoEngine::evaluate(std::vector<Child>& children, const Cluster& c){
+	std::atomic<std::size_t> next(0);
+	auto work = [&]{
+		std::size_t i;
+		while((i = next++) < children.size()){
+			Child& child = children[i];
+			child.sch = nullptr;
+			if(!SchNode::quick_check(child.tree, c)) continue;
+			// Most layers are the same as in the first parent.
+			SchNode::setReuse(child.base);
+			child.sch = SchNode::newNode(child.tree, c, nullptr);
+			SchNode::setReuse(nullptr);
+			if(!child.sch->is_valid()){
+				delete child.sch;
+				child.sch = nullptr;
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for(unsigned i = 1; i < MIN(num_threads, static_cast<unsigned>(children.size())); ++i){
+		workers.emplace_back(work);
+	}
+	work();
+	for(auto& thr : workers){
+		thr.join();
+	}
+}
+
+void EvoEngine::evo_search(WholeSch& w_sch, const Cluster& c){
+	time_t start_time = std::time(nullptr);
+
+	bool valid_op[SAEngine::NUM_OP];
+	for(int i=0; i<SAEngine::NUM_OP; ++i) valid_op[i] = true;
+	if(network->is_chain()) valid_op[0] = valid_op[1] = false;
+	if(w_sch.tree->get_tot_batch() == 1) valid_op[4] = valid_op[5] = false;
+
+	auto mutate = [&](LTreeNode* tree){
+		UndoLog log;
+		mutator.sa_change(tree, log, valid_op);
+		log.commit();
+	};
+
+	// Population, sorted by cost.
+	std::vector<WholeSch> pop;
+	pop.push_back(w_sch.copy());
+	std::vector<Child> children;
+
+	// Keeps the best distinct RA Trees among pop and children.
+	auto next_gen = [&]{
+		for(auto& child : children){
+			if(child.sch != nullptr){
+				child.tree->confirm();
+				pop.emplace_back(child.tree, child.sch);
+			}else{
+				delete child.tree;
+			}
+		}
+		children.clear();
+		std::stable_sort(pop.begin(), pop.end(), [](const WholeSch& a, const WholeSch& b){
+			return a.sch->get_cost().cost() < b.sch->get_cost().cost();
+		});
+		std::set<TransTable::fp_t> fps;
+		std::vector<WholeSch> new_pop;
+		for(auto& w : pop){
+			if(new_pop.size() < pop_size && fps.insert(TransTable::fingerprint(w.tree, c)).second){
+				new_pop.push_back(w);
+			}else{
+				w.del();
+			}
+		}
+		pop = std::move(new_pop);
+	};
+
+	// Initial population: mutations of w_sch.
+	for(std::size_t i = 1; i < pop_size; ++i){
+		LTreeNode* tree = w_sch.tree->copy();
+		for(std::size_t j = 0; j <= i % 4; ++j){
+			mutate(tree);
+		}
+		children.push_back({tree, w_sch.sch, nullptr});
+	}
+	evaluate(children, c);
+	next_gen();
+
+	int print_intv = MAX(num_gens / 10, 1);
+	int nvalid = 0, ncross = 0;
+	for(int gen = 0; gen < num_gens; ++gen){
+		for(std::size_t i = 0; i < pop_size; ++i){
+			const WholeSch& parent = pop[select(pop)];
+			LTreeNode* tree = parent.tree->copy();
+			if(withProb(cross_prob)){
+				ncross += crossover(tree, pop[select(pop)].tree);
+			}
+			mutate(tree);
+			children.push_back({tree, parent.sch, nullptr});
+		}
+		evaluate(children, c);
+		for(const auto& child : children){
+			nvalid += (child.sch != nullptr);
+		}
+		next_gen();
+
+		if((gen+1) % print_intv == 0){
+			std::cout << gen << ' ' << pop.front().sch->get_cost().cost() << ' ' << pop.back().sch->get_cost().cost() << std::endl;
+		}
+	}
+
+	time_t end_time = std::time(nullptr);
+	int nchildren = MAX(num_gens, 1) * static_cast<int>(pop_size);
+	std::cout << "Elapsed: " << end_time - start_time << "s ";
+	std::cout << "Valid: " << nvalid << " (" << (nvalid*100.0)/nchildren << "%) ";
+	std::cout << "Crossover: " << ncross << " (" << (ncross*100.0)/nchildren << "%)" << std::endl;
+	mutator.flushBuf();
+
+	// Outputs the best RA Tree.
+	w_sch.del();
+	w_sch = pop.front();
+	for(std::size_t i = 1; i < pop.size(); ++i){
+		pop[i].del();
+	}
+}
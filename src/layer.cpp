@@ -1,6 +1,7 @@
 #include "layer.h"
 
 #include <cassert>
+#include <utility>
 
 
 Layer::Layer(const std::string& _name,
@@ -11,19 +12,54 @@ Layer::Layer(const std::string& _name,
 	 ifm_shape(_ifm_shape),
 	 ofm_shape(_ofm_shape),
 	 wgt_shape(_wgt_shape),
-	 bitwidth(8){}
+	 bitwidth(0), wgt_bitwidth(0), own_sparsity(false){}
 
+// wgt_shape is zeroed, since layers without weight never set it.
 Layer::Layer(const std::string& _name)
-	:name(_name), bitwidth(8){}
+	:name(_name), wgt_shape(), bitwidth(0), wgt_bitwidth(0), own_sparsity(false){}
+
+bwidth_t Layer::default_bitwidth = 8;
+bwidth_t Layer::default_wgt_bitwidth = 8;
+Sparsity Layer::default_sparsity;
+
+void Layer::copy_bitwidth(const Layer& act, const Layer& wgt){
+	bitwidth = act.bitwidth;
+	wgt_bitwidth = wgt.wgt_bitwidth;
+}
 
 bwidth_t Layer::get_bitwidth() const{
-	return bitwidth;
+	return (bitwidth > 0) ? bitwidth : default_bitwidth;
+}
+
+bwidth_t Layer::get_wgt_bitwidth() const{
+	return (wgt_bitwidth > 0) ? wgt_bitwidth : default_wgt_bitwidth;
 }
 
 void Layer::set_bitwidth(bwidth_t width){
 	bitwidth = width;
 }
 
+void Layer::set_wgt_bitwidth(bwidth_t width){
+	wgt_bitwidth = width;
+}
+
+bool Layer::has_bitwidth() const{
+	return bitwidth > 0 || wgt_bitwidth > 0;
+}
+
+const Sparsity& Layer::get_sparsity() const{
+	return own_sparsity ? sparsity : default_sparsity;
+}
+
+void Layer::set_sparsity(const Sparsity& sp){
+	sparsity = sp;
+	own_sparsity = true;
+}
+
+bool Layer::has_sparsity() const{
+	return own_sparsity;
+}
+
 const std::string& Layer::get_name() const{
 	return name;
 }
@@ -48,6 +84,10 @@ const fmap_shape& Layer::weight_shape() const{
 	return wgt_shape;
 }
 
+const Layer& Layer::base_layer() const{
+	return *this;
+}
+
 void ConvLayer::Workload::init(){
 	K = (K == 0)?C:K;
 	W = (W == 0)?H:W;
@@ -218,6 +258,40 @@ bool GroupConvLayer::fmap_channel_rel() const{
 	return true;
 }
 
+MatMulLayer::MatMulLayer(const std::string& _name, const Workload& _wl)
+	:GroupConvLayer(_name, [&]{GroupConvLayer::Workload gwl;
+		gwl.G = _wl.G; gwl.C = _wl.G*_wl.L; gwl.K = _wl.G*_wl.N; gwl.H = _wl.M; gwl.W = 1;
+		return gwl;}()), wl(_wl)
+{
+	if(wl.transB){
+		wgt_shape = fmap_shape(wl.G*wl.L, wl.N, 1);
+	}
+}
+
+const MatMulLayer::Workload& MatMulLayer::get_workload() const{
+	return wl;
+}
+
+void MatMulLayer::ofm_to_wgt(fmap_range& ofm_range) const{
+	// B = B, since each batch has its own matrices.
+	ofm_range.w = {0, 1};
+	if(!wl.transB){
+		// C = N, H = L
+		ofm_range.h = {0, wl.L};
+		return;
+	}
+
+	// C = L (of all groups in range), H = N (only part of N if in one group)
+	len_t from_id = ofm_range.c.from / wl.N;
+	len_t to_id = DIVCEIL(ofm_range.c.to, wl.N);
+	if(to_id - from_id == 1){
+		ofm_range.h = {ofm_range.c.from - from_id * wl.N, ofm_range.c.to - from_id * wl.N};
+	}else{
+		ofm_range.h = {0, wl.N};
+	}
+	ofm_range.c = {from_id * wl.L, to_id * wl.L};
+}
+
 FCLayer::FCLayer(const std::string& _name, const Workload& wl)
 	:ConvLayer (_name, [&]{ConvLayer::Workload cwl;
 							cwl.C = wl.C; cwl.K=wl.K; cwl.R=wl.IH; cwl.S=wl.IW; cwl.H=1;
@@ -399,6 +473,10 @@ TransposeLayer::TransposeLayer(const std::string& _name, const TransposeLayer::W
 	pad_h = pad_w = 0;
 }
 
+const TransposeLayer::Workload& TransposeLayer::get_workload() const{
+	return wl;
+}
+
 bool TransposeLayer::set_padded_ifm(const fmap_shape& padded_shape){
 	return padded_shape == padded_ifm_shape;
 }
@@ -411,3 +489,68 @@ void TransposeLayer::ofm_to_ifm(fmap_range& ofm_range) const{
 	wl.get_origin_dim(ofm_range, dim::W) = _ofm_range.w;
 }
 
+FusedLayer::FusedLayer(std::shared_ptr<const Layer> _base, std::vector<std::shared_ptr<const LRLayer>> _posts)
+	:Layer(_base->get_name(), _base->tot_ifmap_shape(), _posts.back()->ofmap_shape(), _base->weight_shape()),
+	 base(std::move(_base)), posts(std::move(_posts))
+{
+	assert(REF_IS_INSTANCE(*base, ConvLayer));
+	for(const auto& post : posts){
+		name += "+" + post->get_name();
+	}
+	// Outputs the ofmap of the last post layer.
+	copy_bitwidth(*posts.back(), *base);
+	if(base->has_sparsity()) set_sparsity(base->get_sparsity());
+}
+
+const Layer& FusedLayer::get_base() const{
+	return *base;
+}
+
+const std::vector<std::shared_ptr<const LRLayer>>& FusedLayer::get_posts() const{
+	return posts;
+}
+
+void FusedLayer::to_base_ofm(fmap_range& ofm_range) const{
+	for(auto it = posts.rbegin(); it != posts.rend(); ++it){
+		(*it)->ofm_to_ifm(ofm_range);
+	}
+}
+
+const fmap_shape& FusedLayer::real_ifmap_shape() const{
+	return base->real_ifmap_shape();
+}
+
+vol_t FusedLayer::weight_size() const{
+	return base->weight_size();
+}
+
+bool FusedLayer::set_padded_ifm(const fmap_shape& padded_shape){
+	// Padding is already set in the base layer.
+	return padded_shape == base->real_ifmap_shape();
+}
+
+access_t FusedLayer::get_num_op(len_t batch_size) const{
+	access_t num_op = base->get_num_op(batch_size);
+	for(const auto& post : posts){
+		num_op += post->get_num_op(batch_size);
+	}
+	return num_op;
+}
+
+void FusedLayer::ofm_to_ifm(fmap_range& ofm_range) const{
+	to_base_ofm(ofm_range);
+	base->ofm_to_ifm(ofm_range);
+}
+
+void FusedLayer::ofm_to_wgt(fmap_range& ofm_range) const{
+	to_base_ofm(ofm_range);
+	base->ofm_to_wgt(ofm_range);
+}
+
+bool FusedLayer::fmap_channel_rel() const{
+	return base->fmap_channel_rel();
+}
+
+const Layer& FusedLayer::base_layer() const{
+	return *base;
+}
@@ -0,0 +1,204 @@
+#include "layerdb.h"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+
+/*
+ * File format: one entry per line.
+ *
+ * S <ctx> <key> <valid> [K B H W order[0..3] energy time extUbuf <mapping>]
+ * M <ctx> <key> <mapping>
+ *
+ * <mapping> = energy time ubuf buffer noc mac util tot_util
+ * <ctx> and <key> are written in hex.
+ */
+
+static void write_hex(std::ostream& os, const LayerDB::key_t& key){
+	static const char digits[] = "0123456789abcdef";
+	for(unsigned char c : key){
+		os << digits[c >> 4] << digits[c & 15];
+	}
+}
+
+static bool read_hex(const std::string& str, LayerDB::key_t& key){
+	if(str.size() % 2 != 0) return false;
+	key.clear();
+	key.reserve(str.size() / 2);
+	for(size_t i = 0; i < str.size(); i += 2){
+		int hi = std::stoi(str.substr(i, 2), nullptr, 16);
+		key.push_back(static_cast<char>(hi));
+	}
+	return true;
+}
+
+static void write_mapping(std::ostream& os, const CoreMapper::CoreMapping& m){
+	os << m.cost.energy << ' ' << m.cost.time << ' ' << m.ubuf << ' ' << m.buffer << ' '
+	   << m.noc << ' ' << m.mac << ' ' << m.util << ' ' << m.tot_util;
+}
+
+// std::stod also accepts "inf", which operator>> does not.
+static void read_mapping(std::istream& is, CoreMapper::CoreMapping& m){
+	std::string s[8];
+	for(int i = 0; i < 8; ++i) is >> s[i];
+	if(!is) return;
+	m.cost.energy = std::stod(s[0]);
+	m.cost.time = std::stoull(s[1]);
+	m.ubuf = std::stod(s[2]);
+	m.buffer = std::stod(s[3]);
+	m.noc = std::stod(s[4]);
+	m.mac = std::stod(s[5]);
+	m.util = std::stod(s[6]);
+	m.tot_util = std::stod(s[7]);
+}
+
+void LayerDB::add_key(key_t& key, const std::string& str){
+	add_key(key, static_cast<std::uint32_t>(str.size()));
+	key.append(str);
+}
+
+LayerDB::LayerDB(const std::string& context)
+	:ctx_hash(hash(context)), sch_hit(0), sch_miss(0), map_hit(0), map_miss(0){}
+
+std::uint64_t LayerDB::hash(const std::string& str){
+	std::uint64_t h = 14695981039346656037ULL;
+	for(unsigned char c : str){
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+size_t LayerDB::load(const std::string& file_name){
+	std::ifstream in(file_name);
+	if(!in) return 0;
+
+	std::ostringstream ctx_os;
+	ctx_os << std::hex << std::setw(16) << std::setfill('0') << ctx_hash;
+	const std::string ctx_str = ctx_os.str();
+
+	size_t num_loaded = 0;
+	std::string line;
+	std::lock_guard<std::mutex> lock(mtx);
+	while(std::getline(in, line)){
+		std::istringstream is(line);
+		std::string type, ctx, key_str;
+		is >> type >> ctx >> key_str;
+		if(!is || ctx != ctx_str) continue;
+
+		key_t key;
+		try{
+			if(!read_hex(key_str, key)) continue;
+			if(type == "S"){
+				SchEntry entry;
+				is >> entry.valid;
+				if(entry.valid){
+					int order[4];
+					std::string e, t, ext;
+					is >> entry.part.K >> entry.part.B >> entry.part.H >> entry.part.W;
+					is >> order[0] >> order[1] >> order[2] >> order[3];
+					is >> e >> t >> ext;
+					read_mapping(is, entry.tileSch);
+					if(!is) continue;
+					for(int i = 0; i < 4; ++i){
+						entry.order[i] = static_cast<std::uint8_t>(order[i]);
+					}
+					entry.totCost.energy = std::stod(e);
+					entry.totCost.time = std::stoull(t);
+					entry.extUbufEnergy = std::stod(ext);
+				}
+				if(!is) continue;
+				num_loaded += schemes.emplace(std::move(key), entry).second;
+			}else if(type == "M"){
+				CoreMapper::CoreMapping mapping;
+				read_mapping(is, mapping);
+				if(!is) continue;
+				num_loaded += mappings.emplace(std::move(key), mapping).second;
+			}
+		}catch(const std::logic_error&){
+			// Skip broken lines.
+			continue;
+		}
+	}
+	return num_loaded;
+}
+
+bool LayerDB::save(const std::string& file_name) const{
+	std::ofstream out(file_name, std::ios::app);
+	if(!out) return false;
+	out.precision(std::numeric_limits<double>::max_digits10);
+
+	std::lock_guard<std::mutex> lock(mtx);
+	auto write_head = [&](char type, const key_t& key){
+		out << type << ' ' << std::hex << std::setw(16) << std::setfill('0') << ctx_hash << std::dec << ' ';
+		write_hex(out, key);
+	};
+	for(const key_t& key : new_schemes){
+		const SchEntry& entry = schemes.at(key);
+		write_head('S', key);
+		out << ' ' << entry.valid;
+		if(entry.valid){
+			out << ' ' << entry.part.K << ' ' << entry.part.B << ' ' << entry.part.H << ' ' << entry.part.W;
+			for(int i = 0; i < 4; ++i){
+				out << ' ' << static_cast<int>(entry.order[i]);
+			}
+			out << ' ' << entry.totCost.energy << ' ' << entry.totCost.time << ' ' << entry.extUbufEnergy << ' ';
+			write_mapping(out, entry.tileSch);
+		}
+		out << '\n';
+	}
+	for(const key_t& key : new_mappings){
+		write_head('M', key);
+		out << ' ';
+		write_mapping(out, mappings.at(key));
+		out << '\n';
+	}
+	return static_cast<bool>(out);
+}
+
+bool LayerDB::find_scheme(const key_t& key, SchEntry& entry) const{
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = schemes.find(key);
+	if(it == schemes.end()){
+		++sch_miss;
+		return false;
+	}
+	++sch_hit;
+	entry = it->second;
+	return true;
+}
+
+void LayerDB::add_scheme(const key_t& key, const SchEntry& entry){
+	std::lock_guard<std::mutex> lock(mtx);
+	if(schemes.emplace(key, entry).second){
+		new_schemes.push_back(key);
+	}
+}
+
+bool LayerDB::find_mapping(const key_t& key, CoreMapper::CoreMapping& mapping) const{
+	std::lock_guard<std::mutex> lock(mtx);
+	auto it = mappings.find(key);
+	if(it == mappings.end()){
+		++map_miss;
+		return false;
+	}
+	++map_hit;
+	mapping = it->second;
+	return true;
+}
+
+void LayerDB::add_mapping(const key_t& key, const CoreMapper::CoreMapping& mapping){
+	std::lock_guard<std::mutex> lock(mtx);
+	if(mappings.emplace(key, mapping).second){
+		new_mappings.push_back(key);
+	}
+}
+
+void LayerDB::print_stats(std::ostream& os) const{
+	std::lock_guard<std::mutex> lock(mtx);
+	os << "LayerDB: " << schemes.size() << " schemes (hit " << sch_hit << '/' << sch_hit + sch_miss << "), ";
+	os << mappings.size() << " mappings (hit " << map_hit << '/' << map_hit + map_miss << "), ";
+	os << new_schemes.size() + new_mappings.size() << " new entries." << std::endl;
+}
@@ -1,7 +1,12 @@
 #include "layerengine.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <utility>
+#include <vector>
 
+#include "layerdb.h"
 #include "network.h"
 #include "partition.h"
 
@@ -10,17 +15,59 @@ bool LayerScheme::isValid() const{
 	return totCost.isValid();
 }
 
-StdLayerEngine::StdLayerEngine(CoreMapper* _mapper):mapper(_mapper){}
+StdLayerEngine::StdLayerEngine(CoreMapper* _mapper):db(nullptr), screen(nullptr), screen_k(0), mapper(_mapper){}
+
+void StdLayerEngine::set_db(LayerDB* _db){
+	db = _db;
+	mapper->set_db(_db);
+}
+
+void StdLayerEngine::set_screen(CoreMapper* _screen, std::size_t k){
+	screen = _screen;
+	screen_k = k;
+}
 
 vol_t StdLayerEngine::get_ubuf_size() const{
 	return mapper->get_ubuf_size();
 }
 
+LayerScheme StdLayerEngine::search(LNode* curNode) const{
+	if(db == nullptr) return fullSearch(curNode);
+
+	LayerDB::key_t key = dbKey(curNode);
+	LayerDB::SchEntry entry;
+	LayerScheme layerSch;
+	if(db->find_scheme(key, entry)){
+		if(entry.valid){
+			layerSch.totCost = entry.totCost;
+			layerSch.extUbufEnergy = entry.extUbufEnergy;
+			layerSch.tileSch = entry.tileSch;
+			layerSch.place.part = entry.part;
+			memcpy(layerSch.place.order, entry.order, sizeof(entry.order));
+			initPlaceSch(layerSch.place, curNode);
+			finalizeScheme(layerSch, curNode);
+		}
+		return layerSch;
+	}
+
+	layerSch = fullSearch(curNode);
+	entry.valid = layerSch.isValid();
+	if(entry.valid){
+		entry.part = layerSch.place.part;
+		memcpy(entry.order, layerSch.place.order, sizeof(entry.order));
+		entry.totCost = layerSch.totCost;
+		entry.extUbufEnergy = layerSch.extUbufEnergy;
+		entry.tileSch = layerSch.tileSch;
+	}
+	db->add_scheme(key, entry);
+	return layerSch;
+}
+
 /**
- * @brief StdLayerEngine::search.
+ * @brief StdLayerEngine::fullSearch.
  * Searches partition and placement of each layer.
  * The procedure is as follows
- *  for each partition:
+ *  for each partition (or the best screen_k partitions ranked by screen):
  *      estimate max ubuf usage
  *      search for intra-tile dataflow
  *      calculate ubuf energy (outside tile)
@@ -30,9 +77,11 @@ vol_t StdLayerEngine::get_ubuf_size() const{
  *
  * @return LayerScheme.
  */
-LayerScheme StdLayerEngine::search(LNode* curNode) const{
+LayerScheme StdLayerEngine::fullSearch(LNode* curNode, PartEngine& parts, bool approx) const{
 	// The final scheme
 	LayerScheme layerSch;
+	// Approximate schemes only count total hops, as in the search below.
+	if(approx) layerSch.noc = NoC(false);
 
 	/* ########## Constant infos ########## */
 
@@ -43,7 +92,7 @@ LayerScheme StdLayerEngine::search(LNode* curNode) const{
 	const fmap_shape& ofmShape = layer.ofmap_shape();
 	const len_t totBatch = LNode::tot_batch;
 	const len_t B = curNode->num_batch;
-	const bool wgt_B = layerT.hasWgtPrevs();
+	const bool wgt_B = layerT.hasFmapWgt();
 
 	const cidx_t numCores = cluster.num_cores();
 	const Core::Buffer& ubuf = mapper->core().ubuf();
@@ -57,58 +106,37 @@ LayerScheme StdLayerEngine::search(LNode* curNode) const{
 	NoC noc(false);
 
 	PlaceSch placeSch;
-	{
-		pos_t* permOrder = new pos_t[numCores];
-		placeSch.permuteOrder.reset(permOrder);
-		placeSch.ifmLayout = std::make_unique<StdDataLayout>(numCores, permOrder);
-		if(layer.weight_size() > 0)
-			placeSch.wgtLayout = std::make_unique<StdDataLayout>(numCores, permOrder);
-		else
-			placeSch.wgtLayout = std::make_unique<StdDataLayout>(0, nullptr);
-		placeSch.ofmLayout = std::make_unique<StdULayout>(numCores, permOrder);
-		// permOrder = nullptr; // Handled to placeSch.permuteOrder
-	}
+	initPlaceSch(placeSch, curNode);
 
 	PartSch& partSch = placeSch.part;
 
 	/* ########## Search iterations ########## */
 
 	// For ubuf energy
-	const energy_t ubufOfm = ofmShape.tot_size(B) * ubuf.RCost;
+	const energy_t ubufOfm = placeSch.ofmLayout->dataVol(ofmShape.tot_size(B)) * ubuf.RCost;
 	energy_t ubufTotal;
 
+	// MAC energy relative to 8-bit MACs, scales with the bitwidth of each operand.
+	const bwidth_t ifmBits = network->ifm_bitwidth(curNode->layerid);
+	const bwidth_t wgtBits = network->wgt_bitwidth(curNode->layerid);
+	const double macScale = ifmBits / 8.0 * (layer.weight_size() > 0 ? wgtBits / 8.0 : 1);
+	// MAC energy of zero weights is saved (the mapper only scales the MAC time, see ConvWl::density).
+	const double density = (layer.weight_size() > 0 && !wgt_B) ? layer.get_sparsity().get_density() : 1;
+
 	// Minimal cuts on ifmap. Ifmap tile should not use too much ubuf.
 	len_t minCuts = 0;
-	if(REF_IS_INSTANCE(layer, ConvLayer) && !REF_IS_INSTANCE(layer, GroupConvLayer))
-		minCuts = static_cast<len_t>(layer.real_ifmap_shape().tot_size(B) / (totUbufSize*0.8) + 1);
+	if(REF_IS_INSTANCE(layer.base_layer(), ConvLayer) && !REF_IS_INSTANCE(layer.base_layer(), GroupConvLayer))
+		minCuts = static_cast<len_t>(placeSch.ifmLayout->dataVol(layer.real_ifmap_shape().tot_size(B)) / (totUbufSize*0.8) + 1);
 
 	// Iterator over all valid partitions.
-	auto partIter = partEngine.init(numCores, B, layerT, partSch, minCuts);
+	auto partIter = parts.init(numCores, B, layerT, partSch, minCuts);
 	if(!partIter){
 		// No partition found!
 		return layerSch;
 	}
 
-	// Iter all partitions.
-	do{
-		assert(partSch.size() == static_cast<unsigned>(numCores));
-
-		// Init partition
-		initLayouts(placeSch, layerT, ofmShape, B);
-
-		// Estimate buffer usage
-		vol_t estimatedBuf = ofm_ubuf_vol;
-		estimatedBuf += placeSch.ifmLayout->maxRange();
-		estimatedBuf += placeSch.wgtLayout->maxRange();
-		if(estimatedBuf > ubuf.Size) continue;
-
-		// Search for intra-tile dataflow
-		tileSch = mapper->genLayerMap(layer, partSch, B, wgt_B);
-		if(!tileSch.cost.is_valid()) continue;
-		curCost.energy = tileSch.cost.energy * numCores;
-		curCost.time = tileSch.cost.time;
-
-		// Calc ubuf energy
+	// Calc ubuf energy of current partition.
+	auto calcUbuf = [&]{
 		// TODO: default to not pinning weights.
 		energy_t ubufWgt = placeSch.wgtLayout->totalSize() * ubuf.WCost;
 		// weight ubuf energy should only count once,
@@ -117,6 +145,17 @@ LayerScheme StdLayerEngine::search(LNode* curNode) const{
 
 		ubufTotal = ubufWgt + ubufOfm;
 		ubufTotal += placeSch.ifmLayout->totalSize() * ubuf.WCost;
+	};
+
+	// Searches current partition (layouts are already set).
+	auto searchPart = [&]{
+		// Search for intra-tile dataflow
+		tileSch = mapper->genLayerMap(layer, partSch, B, wgt_B, macScale * density, ifmBits, wgtBits);
+		if(!tileSch.cost.is_valid()) return;
+		curCost.energy = tileSch.cost.energy * numCores;
+		curCost.time = tileSch.cost.time;
+
+		calcUbuf();
 		curCost.energy += ubufTotal;
 
 		// Iterate over all placements.
@@ -142,9 +181,48 @@ LayerScheme StdLayerEngine::search(LNode* curNode) const{
 				layerSch.tileSch = tileSch;
 				layerSch.place.update(std::move(placeSch));
 			}
-		}while(placeIter.nextPlace(/*curCost.cost()*/));
+		}while(!approx && placeIter.nextPlace(/*curCost.cost()*/));
+	};
+
+	// With screening, partitions are first ranked by their estimated cost (without NoC).
+	const bool screening = (screen != nullptr && screen_k > 0);
+	std::vector<std::pair<cost_t, PartSch>> ranked;
+
+	// Iter all partitions.
+	do{
+		assert(partSch.size() == static_cast<unsigned>(numCores));
+
+		// Init partition
+		initLayouts(placeSch, layerT, ofmShape, B);
+
+		// Estimate buffer usage
+		vol_t estimatedBuf = ofm_ubuf_vol;
+		estimatedBuf += placeSch.ifmLayout->maxRange();
+		estimatedBuf += placeSch.wgtLayout->maxRange();
+		if(estimatedBuf > ubuf.Size) continue;
+
+		if(screening){
+			CoreMapper::CoreMapping estSch = screen->genLayerMap(layer, partSch, B, wgt_B, macScale * density, ifmBits, wgtBits);
+			calcUbuf();
+			SchNode::SchCost estCost(estSch.cost.energy * numCores + ubufTotal, estSch.cost.time);
+			ranked.emplace_back(estCost.cost(), partSch);
+			continue;
+		}
+		searchPart();
 	}while(partIter.nextPart(/*curCost.cost()*/));
 
+	// Only the best screen_k partitions are searched exactly.
+	if(screening){
+		std::stable_sort(ranked.begin(), ranked.end(), [](const std::pair<cost_t, PartSch>& a, const std::pair<cost_t, PartSch>& b){
+			return a.first < b.first;
+		});
+		for(std::size_t i = 0; i < MIN(screen_k, ranked.size()); ++i){
+			partSch = ranked[i].second;
+			initLayouts(placeSch, layerT, ofmShape, B);
+			searchPart();
+		}
+	}
+
 	/* ########## Update optimal scheme ########## */
 
 	if(layerSch.isValid()){
@@ -154,22 +232,91 @@ LayerScheme StdLayerEngine::search(LNode* curNode) const{
 		layerSch.place.ofmLayout = std::move(placeSch.ofmLayout);
 		layerSch.place.permuteOrder = std::move(placeSch.permuteOrder);
 
-		/* ##### Re-calculate placement scheme & NoC ##### */
+		finalizeScheme(layerSch, curNode);
+	}
 
-		// Init partition
-		initLayouts(layerSch.place, layerT, ofmShape, B);
+	return layerSch;
+}
 
-		// Init placement
-		layerSch.place.initPlacement(cluster);
+ApproxLayerEngine::ApproxLayerEngine(CoreMapper* _mapper, double min_util)
+	:StdLayerEngine(_mapper), parts(min_util){}
 
-		// Finalize layerSch.place
-		layerSch.place.finalize();
+LayerScheme ApproxLayerEngine::search(LNode* curNode) const{
+	return fullSearch(curNode, parts, true);
+}
 
-		// Update NoC
-		calcNoC(layerSch.noc, layerSch.place, curNode);
-	}
+void StdLayerEngine::initPlaceSch(PlaceSch& place, const LNode* curNode) const{
+	const cidx_t numCores = curNode->cluster.num_cores();
+	const bool hasWgt = curNode->layert.layer().weight_size() > 0;
+	pos_t* permOrder = new pos_t[numCores];
+	place.permuteOrder.reset(permOrder);
+	place.ifmLayout = std::make_unique<StdDataLayout>(numCores, permOrder);
+	if(hasWgt)
+		place.wgtLayout = std::make_unique<StdDataLayout>(numCores, permOrder);
+	else
+		place.wgtLayout = std::make_unique<StdDataLayout>(0, nullptr);
+	place.ofmLayout = std::make_unique<StdULayout>(numCores, permOrder);
+	// permOrder = nullptr; // Handled to place.permuteOrder
+
+	place.ifmLayout->setBitwidth(network->ifm_bitwidth(curNode->layerid));
+	place.wgtLayout->setBitwidth(network->wgt_bitwidth(curNode->layerid));
+	if(hasWgt && !curNode->layert.hasFmapWgt()) place.wgtLayout->setSparsity(curNode->layert.layer().get_sparsity());
+	place.ofmLayout->setBitwidth(curNode->layert.layer().get_bitwidth());
+}
 
-	return layerSch;
+void StdLayerEngine::finalizeScheme(LayerScheme& layerSch, LNode* curNode) const{
+	/* ##### Re-calculate placement scheme & NoC ##### */
+
+	// Init partition
+	initLayouts(layerSch.place, curNode->layert, curNode->layert.layer().ofmap_shape(), curNode->num_batch);
+
+	// Init placement
+	layerSch.place.initPlacement(curNode->cluster);
+
+	// Finalize layerSch.place
+	layerSch.place.finalize();
+
+	// Update NoC
+	calcNoC(layerSch.noc, layerSch.place, curNode);
+}
+
+std::string StdLayerEngine::dbKey(const LNode* curNode) const{
+	LayerDB::key_t key;
+	auto add_cluster = [&](const Cluster& c){
+		pos_t first = c[0];
+		LayerDB::add_key(key, c.num_cores());
+		LayerDB::add_key(key, first.x);
+		LayerDB::add_key(key, first.y);
+	};
+
+	// The layer and its inputs (by shape class, thus shared by identical layers).
+	LayerDB::add_key(key, network->shape_sig(curNode->layerid));
+
+	// The LNode.
+	add_cluster(curNode->cluster);
+	LayerDB::add_key(key, curNode->num_batch);
+	LayerDB::add_key(key, LNode::tot_batch);
+	LayerDB::add_key(key, curNode->to_dram);
+
+	// Layouts of direct prevs, each by its position in prevs.
+	const Bitset& prevs = curNode->layert.getPrevs();
+	FOR_BITSET(prev, curNode->get_dirp_set()){
+		const LNode* fromNode = (*(curNode->lnodeList))[prev];
+		const PlaceSch& fromPlace = fromNode->get_place_sch();
+		lid_t pos = 0;
+		FOR_BITSET(p, prevs){
+			if(p == prev) break;
+			++pos;
+		}
+		LayerDB::add_key(key, pos);
+		add_cluster(fromNode->cluster);
+		LayerDB::add_key(key, fromNode->num_batch);
+		for(std::uint8_t i = 0; i < 4; ++i){
+			LayerDB::add_key(key, fromPlace.part[i]);
+			LayerDB::add_key(key, fromPlace.order[i]);
+		}
+	}
+	return key;
 }
 
 void StdLayerEngine::initLayouts(PlaceSch& place, const Node& layerT, const fmap_shape& ofmShape, len_t B) const{
@@ -179,7 +326,7 @@ void StdLayerEngine::initLayouts(PlaceSch& place, const Node& layerT, const fmap
 	const Layer& layer = layerT.layer();
 	const bool fmap_K = layer.fmap_channel_rel();
 	const bool hasWgt = layer.weight_size() > 0;
-	const bool wgt_B = layerT.hasWgtPrevs();
+	const bool wgt_B = layerT.hasFmapWgt();
 
 	// Intervals on each dimension.
 	const len_t* arrs[4];
@@ -289,12 +436,29 @@ void StdLayerEngine::calcNoC(NoC& noc, const PlaceSch& place, LNode* curNode) co
 
 	const Node& layerT = curNode->layert;
 	const len_t B = curNode->num_batch;
-	const bool wgt_B = layerT.hasWgtPrevs();
+	const bool wgt_B = layerT.hasFmapWgt();
 
 	len_t curC;
 
 	// Fetch weight first.
-	if(wgt_B){
+	if(wgt_B && REF_IS_INSTANCE(layerT.layer().base_layer(), MatMulLayer)){
+		// Rows of weight: external data (e.g. KV cache) from remote MEM,
+		// then each prev layer from its ofmap/mem layout.
+		len_t curH = layerT.get_external_wgt_H();
+		noc.fromRemoteMemH(place.getWgtL(), 0, curH);
+		FOR_BITSET(prev, layerT.getWgtPrevs()){
+			const len_t prevH = network->getNode(prev).layer().ofmap_shape().h;
+			if(curNode->get_dirp_set().contains(prev)){
+				const LNode* fromNode = (*(curNode->lnodeList))[prev];
+				const auto& fromLayout = fromNode->get_place_sch().getOfmL();
+				noc.betweenLayout(fromLayout, place.getWgtL(), 0, fromNode->num_batch, B, curH);
+			}else{
+				noc.fromRemoteMemH(place.getWgtL(), curH, curH + prevH);
+			}
+			curH += prevH;
+		}
+		assert(curH == layerT.layer().weight_shape().h);
+	}else if(wgt_B){
 		// Fetch each prev layer from its ofmap/mem layout
 		curC = 0;
 		const auto& prevs = layerT.getWgtPrevs();
@@ -1,6 +1,7 @@
 #include "ltreenode.h"
 
 #include <cassert>
+#include <stdexcept>
 
 #include "network.h"
 
@@ -60,6 +61,179 @@ LTreeNode* LTreeNode::copy() const{
 	return l;
 }
 
+void LTreeNode::save(std::ostream& os, std::string pad) const{
+	os << pad;
+	switch(t){
+		case NodeType::L:
+			os << "L " << num_batch << ' ' << network->getNode(layer_set.first()).name() << std::endl;
+			return;
+		case NodeType::T:
+			os << "T " << num_batch << ' ' << children.size();
+			break;
+		case NodeType::S:
+			os << "S " << num_batch << ' ' << children.size();
+			for(lid_t s : stage){
+				os << ' ' << s;
+			}
+			break;
+	}
+	os << std::endl;
+	pad += '\t';
+	for(auto child: children){
+		child->save(os, pad);
+	}
+}
+
+LTreeNode* LTreeNode::load(std::istream& is, len_t tot_batch){
+	lid_t num_layer = network->len();
+	std::unordered_map<std::string, lid_t> ids;
+	for(lid_t i = 0; i < num_layer; ++i){
+		ids[network->getNode(i).name()] = i;
+	}
+
+	Bitset loaded;
+	LTreeNode* root = load_node(is, ids, loaded);
+	if(root == nullptr) return nullptr;
+	if(root->t != NodeType::T){
+		LTreeNode* new_root = new LTreeNode(Bitset(), root->num_batch, nullptr, NodeType::T);
+		root->parent = new_root;
+		new_root->add(root);
+		root = new_root;
+	}
+	if(root->num_batch != tot_batch || !root->check_batch()){
+		delete root;
+		return nullptr;
+	}
+
+	// Leaves in prefix order.
+	std::vector<LTreeNode*> leaves;
+	auto get_leaves = [&](){
+		leaves.clear();
+		std::vector<LTreeNode*> stack = {root};
+		while(!stack.empty()){
+			LTreeNode* cur = stack.back();
+			stack.pop_back();
+			if(cur->t == NodeType::L){
+				leaves.push_back(cur);
+				continue;
+			}
+			for(auto it = cur->children.rbegin(); it != cur->children.rend(); ++it){
+				stack.push_back(*it);
+			}
+		}
+	};
+
+	// Adds missing layers (in id order, so all prevs are added before).
+	for(lid_t i = 0; i < num_layer; ++i){
+		if(loaded.contains(i)) continue;
+		get_leaves();
+		const Bitset& prevs = network->getNode(i).getPrevs();
+		LTreeNode* last_prev = nullptr;
+		for(LTreeNode* leaf : leaves){
+			if(prevs.contains(leaf->layer_set.first())) last_prev = leaf;
+		}
+		LTreeNode* par = (last_prev == nullptr) ? root : last_prev->parent;
+		auto pos = par->children.begin();
+		if(last_prev != nullptr){
+			while(*pos != last_prev) ++pos;
+			++pos;
+		}
+		LTreeNode* node = new LTreeNode(i, par->children.front()->num_batch);
+		node->parent = par;
+		par->children.insert(pos, node);
+		loaded.set(i);
+	}
+
+	// Checks that all prevs of each layer are before it.
+	get_leaves();
+	Bitset before;
+	for(LTreeNode* leaf : leaves){
+		lid_t id = leaf->layer_set.first();
+		if(!((before | network->getNode(id).getPrevs()) == before)){
+			delete root;
+			return nullptr;
+		}
+		before.set(id);
+	}
+
+	root->init_root();
+	return root;
+}
+
+LTreeNode* LTreeNode::load_node(std::istream& is, const std::unordered_map<std::string, lid_t>& ids, Bitset& loaded){
+	std::string type;
+	len_t batch;
+	is >> type >> batch;
+	if(!is || batch == 0){
+		throw std::invalid_argument("RA tree format not recognized!");
+	}
+
+	if(type == "L"){
+		std::string name;
+		is >> name;
+		if(!is){
+			throw std::invalid_argument("RA tree format not recognized!");
+		}
+		auto it = ids.find(name);
+		if(it == ids.end() || loaded.contains(it->second)) return nullptr;
+		loaded.set(it->second);
+		return new LTreeNode(it->second, batch);
+	}
+
+	size_t num_children;
+	is >> num_children;
+	if(type == "S"){
+		lid_t stage;
+		for(size_t i = 0; i < num_children; ++i) is >> stage;
+	}else if(type != "T"){
+		throw std::invalid_argument("RA tree node type \"" + type + "\" not recognized!");
+	}
+	if(!is){
+		throw std::invalid_argument("RA tree format not recognized!");
+	}
+
+	LTreeNode* node = new LTreeNode(Bitset(), batch, nullptr, (type == "S") ? NodeType::S : NodeType::T);
+	try{
+		for(size_t i = 0; i < num_children; ++i){
+			LTreeNode* child = load_node(is, ids, loaded);
+			if(child == nullptr) continue;
+			child->parent = node;
+			node->add(child);
+		}
+	}catch(...){
+		delete node;
+		throw;
+	}
+
+	switch(node->children.size()){
+		case 0:
+			delete node;
+			return nullptr;
+		case 1:{
+			// Replace the cut with its only child.
+			LTreeNode* child = node->children.front();
+			node->children.clear();
+			delete node;
+			child->parent = nullptr;
+			child->num_batch = batch;
+			return child;
+		}
+		default:
+			return node;
+	}
+}
+
+bool LTreeNode::check_batch() const{
+	if(t == NodeType::L) return true;
+
+	len_t child_batch = children.front()->num_batch;
+	if(num_batch % child_batch != 0) return false;
+	for(auto child: children){
+		if(child->num_batch != child_batch || !child->check_batch()) return false;
+	}
+	return true;
+}
+
 void LTreeNode::reset_lset(){
 	layer_set.clear();
 }
@@ -276,3 +450,89 @@ void LTreeNode::traverse_pass2(){
 
 	if(t == NodeType::S) unit_time = (unit_time * (num_bgrp + num_stage)) / num_bgrp;
 }
+
+
+/* #################### UndoLog #################### */
+
+UndoLog::UndoLog():num_entries(0){}
+
+UndoLog::~UndoLog(){
+	commit();
+}
+
+void UndoLog::save(LTreeNode* node){
+	if(num_entries == entries.size()) entries.emplace_back();
+	Entry& e = entries[num_entries++];
+	e.node = node;
+	e.t = node->t;
+	e.isNewNode = node->isNewNode;
+	e.modified = node->modified;
+	e.height = node->height;
+	e.parent = node->parent;
+	e.children = node->children;
+	e.layer_set = node->layer_set;
+	e.unit_time = node->unit_time;
+	e.num_bgrp = node->num_bgrp;
+	e.num_batch = node->num_batch;
+	e.stage = node->stage;
+	e.num_stage = node->num_stage;
+	e.to_dram = node->to_dram;
+	e.dirp_set = node->dirp_set;
+}
+
+void UndoLog::save_subtree(LTreeNode* node){
+	save(node);
+	for(auto child : node->children){
+		save_subtree(child);
+	}
+}
+
+void UndoLog::add_created(LTreeNode* node){
+	created.push_back(node);
+}
+
+void UndoLog::add_removed(LTreeNode* node){
+	assert(node->children.empty());
+	removed.push_back(node);
+}
+
+void UndoLog::commit(){
+	for(LTreeNode* node : removed){
+		delete node;
+	}
+	removed.clear();
+	created.clear();
+	num_entries = 0;
+}
+
+void UndoLog::rollback(LTreeNode* root){
+	// In reverse order, so the first record of each node is restored last.
+	while(num_entries > 0){
+		Entry& e = entries[--num_entries];
+		LTreeNode* node = e.node;
+		node->t = e.t;
+		node->isNewNode = e.isNewNode;
+		node->modified = e.modified;
+		node->height = e.height;
+		node->parent = e.parent;
+		node->children.swap(e.children);
+		node->layer_set = e.layer_set;
+		node->unit_time = e.unit_time;
+		node->num_bgrp = e.num_bgrp;
+		node->num_batch = e.num_batch;
+		node->stage.swap(e.stage);
+		node->num_stage = e.num_stage;
+		node->to_dram = e.to_dram;
+		node->dirp_set = e.dirp_set;
+	}
+	for(LTreeNode* node : created){
+		node->children.clear();
+		delete node;
+	}
+	created.clear();
+	removed.clear();
+
+	// Other nodes may also be changed in init_root() of the new tree.
+	root->init_root();
+	root->confirm();
+}
@@ -1,27 +1,32 @@
+#include "blocks.h"
 #include "cluster.h"
+#include "cooling.h"
+#include "dp.h"
+#include "evo.h"
+#include "layerdb.h"
 #include "layerengine.h"
 #include "ltreenode.h"
 #include "noc.h"
+#include "resultwriter.h"
 #include "schnode.h"
 #include "util.h"
 #include "nns/nns.h"
 
 #include "sa.h"	         // Library for SA
 
-#ifndef NOT_GEN_IR
-#include "json/json.h"   // Json::StyledWriter
-#endif
-
 #include <cassert>       // assert
 #include <cmath>         // std::pow
 #include <cstdlib>       // std::srand, std::atoi
 #include <ctime>         // std::time
-#include <fstream>       // std::ifstream, std::ofstream
+#include <fstream>       // std::ifstream
 #include <functional>    // std::ref
 #include <iostream>      // std::cin, std::cout, std::endl
+#include <memory>        // std::unique_ptr
+#include <sstream>       // std::ostringstream, std::istringstream
 #include <string>        // std::string
 #include <thread>        // std::thread
 #include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
 
 
 static const std::unordered_map<std::string, const Network*> All_Networks = {
@@ -40,7 +45,11 @@ static const std::unordered_map<std::string, const Network*> All_Networks = {
 	{"pnas", &PNASNet},
 	{"bert", &BERT_block},
 	{"gpt_prefill", &GPT2_prefill_block},
-	{"gpt_decode", &GPT2_decode_block}
+	{"gpt_decode", &GPT2_decode_block},
+	// Full LLMs.
+	{"bert_full", &BERT},
+	{"gpt_prefill_full", &GPT2_prefill},
+	{"gpt_decode_full", &GPT2_decode}
 };
 
 #define KB *1024
@@ -48,6 +57,16 @@ static const std::unordered_map<std::string, const Network*> All_Networks = {
 // Core-related hardware parameters defined in this function.
 static void init_core(const std::string& core_type, Core*& core, CoreMapper*& cMapper);
 
+// Initial RA Tree: all layers under the top T cut, with the largest valid batch size.
+// Returns an empty WholeSch if no batch size is valid.
+static WholeSch init_search(len_t tot_batch, const Cluster& c);
+
+// Loads an RA Tree saved by LTreeNode::save(), returns an empty WholeSch if it is not valid.
+static WholeSch load_search(std::istream& is, len_t tot_batch, const Cluster& c);
+
+// Runs SA_search of all engines in parallel from "init_sch", returns the best result.
+static WholeSch SET_search(SAEngine* const* engines, int tries, const WholeSch& init_sch, const Cluster& c);
+
 int main(int argc, char** argv){
 	unsigned seed = std::time(nullptr);
 	std::srand(seed);
@@ -100,9 +119,57 @@ int main(int argc, char** argv){
 	// Rounds of SA = urounds * #layers
 	int urounds = 100;
 
+	// File of LayerDB, empty if not used. (only set in config file)
+	std::string layer_db_file;
+
+	// File of the RA tree to start SET from, empty if not used. (only set in config file)
+	std::string init_tree_file;
+
+	// Number of subtrees cached by each SA engine, 0 to disable. (only set in config file)
+	int sa_cache = 256;
+
+	// Transposition table of SA, 0: none, 1: for each search, 2: shared by all threads. (only set in config file)
+	int sa_table = 1;
+
+	// Whether SA picks OPs adaptively by their rewards. (only set in config file)
+	bool adaptive_op = false;
+
+	// Cooling schedule of SA, "fixed" or "adaptive". (only set in config file)
+	std::string cooling = "fixed";
+
+	// Whether SA screens new RA trees by an approximate layer search. (only set in config file)
+	bool sa_approx = false;
+
+	// Maximal #layers in a segment of DP, 0 to disable DP. (only set in config file)
+	int dp_len = 0;
+
+	// Number of generations of the evolutionary search, 0 to disable. (only set in config file)
+	int evo_gens = 0;
+
+	// Number of partitions (ranked by RooflineMapper) searched exactly in each layer, 0 for all. (only set in config file)
+	int screen_k = 0;
+
+	// The network with a single block, to schedule "net" by its repeated blocks. (only set in config file)
+	std::string block_net_name;
+
+	// KV-cache lengths [from, to] (with step) of gpt_decode to sweep, step 0 to disable. (only set in config file)
+	len_t sweep_from = 0, sweep_to = 0, sweep_step = 0;
+
+	// Whether PTP/Pooling layers are fused into the layers before them. (only set in config file)
+	bool fuse = false;
+
+	// Default bitwidths of activations and weights (of layers without their own). (only set in config file)
+	int act_bits = 8, wgt_bits = 8;
+
+	// Default sparsity of weights: N:M inside blocks of the density (of layers without their own). (only set in config file)
+	len_t sparse_N = 1, sparse_M = 1;
+	double sparse_density = 1;
+
 #ifndef NOT_GEN_IR
 	// Whether generate IR or not.
 	bool gen_IR = true;
+	// Whether replay the IR in Simulator or not. (only set in config file)
+	bool sim_IR = false;
 #endif
 
 	// Read from file / args
@@ -170,9 +237,64 @@ int main(int argc, char** argv){
 					in >> cf_param;
 				}else if(config_name == "round"){
 					in >> urounds;
+				}else if(config_name == "layer_db"){
+					in >> layer_db_file;
+				}else if(config_name == "init_tree"){
+					in >> init_tree_file;
+				}else if(config_name == "sa_cache"){
+					in >> sa_cache;
+				}else if(config_name == "cooling"){
+					in >> cooling;
+					// Throws if the name is not recognized.
+					delete CoolingSchedule::newSchedule(cooling, 1);
+				}else if(config_name == "adaptive_op"){
+					in >> adaptive_op;
+				}else if(config_name == "sa_approx"){
+					in >> sa_approx;
+				}else if(config_name == "evo"){
+					in >> evo_gens;
+					if(evo_gens < 0){
+						throw std::invalid_argument("evo should be non-negative!");
+					}
+				}else if(config_name == "block_net"){
+					in >> block_net_name;
+				}else if(config_name == "decode_sweep"){
+					in >> sweep_from >> sweep_to >> sweep_step;
+					if(sweep_from == 0 || sweep_to < sweep_from || sweep_step == 0){
+						throw std::invalid_argument("decode_sweep should be \"from to step\" with 0 < from <= to and step > 0!");
+					}
+				}else if(config_name == "fuse"){
+					in >> fuse;
+				}else if(config_name == "bitwidth"){
+					in >> act_bits >> wgt_bits;
+					if(act_bits <= 0 || act_bits > 32 || wgt_bits <= 0 || wgt_bits > 32){
+						throw std::invalid_argument("bitwidth should be \"act wgt\" with both in [1, 32]!");
+					}
+				}else if(config_name == "sparsity"){
+					in >> sparse_N >> sparse_M >> sparse_density;
+					if(sparse_N == 0 || sparse_M < sparse_N || !(sparse_density > 0 && sparse_density <= 1)){
+						throw std::invalid_argument("sparsity should be \"N M density\" with 0 < N <= M and 0 < density <= 1!");
+					}
+				}else if(config_name == "screen_k"){
+					in >> screen_k;
+					if(screen_k < 0){
+						throw std::invalid_argument("screen_k should be non-negative!");
+					}
+				}else if(config_name == "dp"){
+					in >> dp_len;
+					if(dp_len < 0){
+						throw std::invalid_argument("dp should be non-negative!");
+					}
+				}else if(config_name == "sa_table"){
+					in >> sa_table;
+					if(sa_table < 0 || sa_table > 2){
+						throw std::invalid_argument("sa_table should be 0, 1 or 2!");
+					}
 #ifndef NOT_GEN_IR
 				}else if(config_name == "IR"){
 					in >> gen_IR;
+				}else if(config_name == "sim"){
+					in >> sim_IR;
 #endif
 				}else{
 					throw std::invalid_argument("Config name \"" + config_name + "\" not recognized!");
@@ -185,6 +307,9 @@ int main(int argc, char** argv){
 		}
 	}
 	if(!exp_name.empty()) exp_name += "_";
+	if(sweep_step > 0 && (net_name != "gpt_decode" || !block_net_name.empty())){
+		throw std::invalid_argument("decode_sweep needs net gpt_decode (and no block_net)!");
+	}
 
 	// Other parameters
 
@@ -193,6 +318,11 @@ int main(int argc, char** argv){
 	// 0.5 (GB/s)/TOPS
 	double rel_dram_bw = 0.5;
 
+	// Data volumes are in 8-bit units (see DataLayout::dataVol).
+	Layer::default_bitwidth = static_cast<bwidth_t>(act_bits);
+	Layer::default_wgt_bitwidth = static_cast<bwidth_t>(wgt_bits);
+	Layer::default_sparsity = Sparsity(sparse_N, sparse_M, sparse_density);
+
 	// NoC and DRAM energy
 	NoC::DRAM_acc_cost = 7.5 * 8;
 	NoC::hop_cost = 0.7 * 8;
@@ -210,6 +340,9 @@ int main(int argc, char** argv){
 	init_core(core_type, core, cMapper);
 	StdLayerEngine engine(cMapper);
 	SchNode::layerMapper = &engine;
+	ApproxLayerEngine approx_engine(cMapper);
+	RooflineMapper roofline(cMapper->core());
+	engine.set_screen(&roofline, static_cast<std::size_t>(screen_k));
 
 	// Cluster initialization
 	Cluster::xlen = x_len;
@@ -234,12 +367,39 @@ int main(int argc, char** argv){
 	}
 
 	// Sets networks
+	const Network* full_net = nullptr;
+	std::unique_ptr<BlockStitcher> stitcher;
+	// Fused networks, if "fuse" is set.
+	std::unique_ptr<Network> fused_net, fused_full_net;
+	auto fuse_net = [&](const Network* net, std::unique_ptr<Network>& fused){
+		fused = std::make_unique<Network>(net->fuse());
+		std::cout << "Fuse: " << net->len() << " layers to " << fused->len() << " nodes." << std::endl;
+		return fused.get();
+	};
 	{
-		auto it = All_Networks.find(net_name);
-		if(it == All_Networks.end()){
-			throw std::invalid_argument("Network \"" + net_name + "\" not found!");
+		auto find_net = [](const std::string& name){
+			auto it = All_Networks.find(name);
+			if(it == All_Networks.end()){
+				throw std::invalid_argument("Network \"" + name + "\" not found!");
+			}
+			if(it->second->len() == 0){
+				throw std::invalid_argument("Network \"" + name + "\" has too many layers, rebuild with a larger MAX_BITS (e.g. \"make clean && make MAX_BITS=4096\").");
+			}
+			return it->second;
+		};
+		network = find_net(net_name);
+		if(fuse) network = fuse_net(network, fused_net);
+		// Searches the block network, and stitches the result to the full network at last.
+		if(!block_net_name.empty()){
+			full_net = network;
+			network = find_net(block_net_name);
+			if(fuse){
+				fused_full_net = std::move(fused_net);
+				network = fuse_net(network, fused_net);
+			}
+			stitcher = std::make_unique<BlockStitcher>(*full_net, *network);
+			std::cout << "Blocks: " << stitcher->get_num() << " blocks of " << stitcher->get_period() << " layers, searched on " << block_net_name << std::endl;
 		}
-		network = it->second;
 	}
 
 	// Sets cost function
@@ -265,12 +425,53 @@ int main(int argc, char** argv){
 	// Sets total batch size
 	SchNode::tot_batch = tot_batch;
 
+	// Sets LayerDB
+	// (also without a file in decode_sweep, to share layer results among lengths)
+	LayerDB* layer_db = nullptr;
+	if(!layer_db_file.empty() || sweep_step > 0){
+		// Everything that affects intra-layer search, except the keys.
+		std::ostringstream context;
+		context.precision(17);
+		cMapper->core().print_config(context);
+		context << ' ' << x_len << ' ' << y_len << ' ' << stride;
+		context << ' ' << NoC::NoC_bw << ' ' << NoC::DRAM_bw;
+		context << ' ' << NoC::hop_cost << ' ' << NoC::DRAM_acc_cost;
+		context << ' ' << ofm_ubuf_vol << ' ' << Cluster::min_util << ' ' << cf_param;
+		// Kept out of the context by default, thus old DB files stay valid.
+		if(screen_k > 0) context << " screen " << screen_k;
+		if(act_bits != 8 || wgt_bits != 8) context << " bits " << act_bits << ' ' << wgt_bits;
+		if(!Layer::default_sparsity.is_dense()) context << " sparse " << Layer::default_sparsity;
+		layer_db = new LayerDB(context.str());
+		if(!layer_db_file.empty()){
+			size_t num_loaded = layer_db->load(layer_db_file);
+			std::cout << "LayerDB: loaded " << num_loaded << " entries from " << layer_db_file;
+			std::cout << " (" << network->num_shape_classes() << " shape classes in " << network->len() << " layers)" << std::endl;
+		}
+		engine.set_db(layer_db);
+	}
+	// Saves and deletes LayerDB at exit.
+	auto close_db = [&]{
+		if(!layer_db) return;
+		if(!layer_db_file.empty() && !layer_db->save(layer_db_file)){
+			std::cout << "Cannot write to " << layer_db_file << std::endl;
+		}
+		layer_db->print_stats();
+		delete layer_db;
+		layer_db = nullptr;
+	};
+
 	// Sets NPT
 	network->set_utime(*cMapper);
 
 	// Sets SA rounds
 	lid_t num_layer = network->len();
 	SAEngine::nrounds = urounds * num_layer;
+	SAEngine::cache_size = static_cast<std::size_t>(MAX(sa_cache, 0));
+	SAEngine::table_mode = sa_table;
+	SAEngine::adaptive_op = adaptive_op;
+	SAEngine::cooling_name = cooling;
+	SAEngine::approx_engine = sa_approx ? &approx_engine : nullptr;
+	EvoEngine::num_gens = evo_gens;
 
 	std::cout << "Seed: " << seed << std::endl;
 	std::cout << "Core " << core_type;
@@ -280,46 +481,128 @@ int main(int argc, char** argv){
 
 	/* ########## Search functions ########## */
 
-	// Initial RA Tree
-	LTreeNode* init_tree = nullptr;
-	SchNode* init_res = nullptr;
-	for(len_t lb = tot_batch; lb>0; lb/=2){
-		init_tree = new LTreeNode(Bitset(), tot_batch, nullptr, LTreeNode::NodeType::T);
-		for(lid_t i = 0; i < num_layer; ++i){
-			(void)new LTreeNode(i, lb, init_tree);
-		}
-		init_tree->init_root();
-		init_res = SchNode::newNode(init_tree, c, nullptr);
-		if(init_res->is_valid()){
-			init_tree->confirm();
-			break;
+	// Result files are written in background.
+	ResultWriter writer(exp_name);
+	writer.print_summary = print_summary;
+	writer.print_scheme = print_scheme;
+	writer.print_tree = print_tree;
+#ifndef NOT_GEN_IR
+	writer.gen_IR = gen_IR;
+	writer.sim_IR = sim_IR;
+#endif
+
+	// Sweeps KV-cache lengths of gpt_decode, instead of the searches below.
+	// Layers with the same shape (e.g. all except attention) are shared among lengths through LayerDB,
+	// and SET of each length starts from the best RA Tree of the previous length, with 1/4 of the rounds.
+	if(sweep_step > 0){
+		SAEngine* sweepEngine[tries];
+		std::unique_ptr<Network> sweep_net;
+		std::string prev_tree;
+		std::ostringstream table;
+		table << "kv_len\tenergy\ttime\tcost" << std::endl;
+		for(len_t kv_len = sweep_from; kv_len <= sweep_to; kv_len += sweep_step){
+			// Results of the previous length are written before switching networks.
+			writer.wait();
+			sweep_net = std::make_unique<Network>(GPT2_decode_block_kv(kv_len));
+			network = sweep_net.get();
+			if(fuse) network = fuse_net(network, fused_net);
+			network->set_utime(*cMapper);
+			SAEngine::clear_shared();
+			std::string name = "KV" + std::to_string(kv_len);
+
+			int full_rounds = urounds * network->len();
+			SAEngine::nrounds = full_rounds;
+			WholeSch start_sch;
+			if(!prev_tree.empty()){
+				std::istringstream in(prev_tree);
+				start_sch = load_search(in, tot_batch, c);
+				if(start_sch) SAEngine::nrounds = MAX(full_rounds / 4, 30);
+			}
+			if(!start_sch){
+				start_sch = init_search(tot_batch, c);
+			}
+			if(!start_sch){
+				std::cout << exp_name << name << " finds no valid solution." << std::endl;
+				continue;
+			}
+
+			// Subtrees cached in engines belong to the previous network.
+			for(int i = 0; i < tries; ++i){
+				sweepEngine[i] = new SAEngine(seed+i, i==0);
+			}
+			WholeSch sweep_sch = SET_search(sweepEngine, tries, start_sch, c);
+			for(int i = 0; i < tries; ++i){
+				delete sweepEngine[i];
+			}
+			start_sch.del();
+
+			if(sweep_sch){
+				const SchNode::SchCost& cost = sweep_sch.sch->get_cost();
+				std::cout << exp_name << name << ": " << sweep_sch.sch << std::endl;
+				table << kv_len << '\t' << cost.energy << '\t' << cost.time << '\t' << cost.cost() << std::endl;
+				writer.write(name, sweep_sch.sch, sweep_sch.tree);
+				std::ostringstream os;
+				sweep_sch.tree->save(os);
+				prev_tree = os.str();
+			}else{
+				std::cout << exp_name << name << " finds no valid solution." << std::endl;
+			}
+			sweep_sch.del();
 		}
-		delete init_tree;
-		delete init_res;
-		init_tree = nullptr;
+		writer.wait();
+		network = nullptr;
+
+		std::cout << table.str();
+		std::ofstream out(exp_name + "decode_sweep.txt");
+		out << table.str();
+
+		close_db();
+		delete cMapper;
+		delete core;
+		return 0;
 	}
-	if(init_tree){
-		std::cout << exp_name << "init: " << init_res << std::endl;
-		if(print_summary){
-			std::ofstream out(exp_name + "init_summary.txt");
-			init_res->print_summary(out);
-		}
-		if(print_scheme){
-			std::ofstream out(exp_name + "init_scheme.txt");
-			init_res->print_scheme("", out);
-		}
-		if(print_tree){
-			std::ofstream out(exp_name + "init_tree.txt");
-			init_res->print_tree("", out);
-		}
+
+	// Initial RA Tree
+	WholeSch init_sch = init_search(tot_batch, c);
+	if(init_sch){
+		std::cout << exp_name << "init: " << init_sch.sch << std::endl;
+		// Currently IR is not generated for the initial RA Tree.
+		writer.write("init", init_sch.sch, init_sch.tree, false);
 	}else{
 		std::cout << exp_name + "init finds no valid solution." << std::endl;
+		writer.wait();
+		close_db();
+		delete cMapper;
+		delete core;
 		return 0;
 	}
 
-	WholeSch init_sch = WholeSch(init_tree, init_res);
-	init_tree = nullptr;
-	init_res = nullptr;
+	// Starting point of SET, loaded from init_tree_file.
+	// (LP and LS always start from init_sch, since their trees have limited depth)
+	WholeSch warm_sch;
+	if(!init_tree_file.empty()){
+		std::ifstream in(init_tree_file);
+		if(!in){
+			throw std::invalid_argument("Cannot read from RA tree file!");
+		}
+		warm_sch = load_search(in, tot_batch, c);
+		if(warm_sch){
+			std::cout << exp_name << "loaded: " << warm_sch.sch << std::endl;
+		}else{
+			std::cout << "RA tree in " << init_tree_file << " is not valid, SET starts from init." << std::endl;
+		}
+	}
+
+	// Optimal tree of consecutive segments by DP, also the starting point of SET (if no init_tree).
+	WholeSch dp_sch;
+	if(dp_len > 0){
+		DPEngine dp(c, tot_batch, tries, static_cast<lid_t>(MIN(dp_len, static_cast<int>(num_layer))));
+		dp.search(dp_sch, true, true);
+		if(dp_sch){
+			std::cout << exp_name << "DP: " << dp_sch.sch << std::endl;
+			writer.write("DP", dp_sch.sch, dp_sch.tree);
+		}
+	}
 
 	WholeSch min_sch = init_sch.copy();
 	// bool SA_only = true;
@@ -348,29 +631,7 @@ int main(int argc, char** argv){
 		}
 		if(cur_sch){
 			std::cout << exp_name << method << ": " << cur_sch.sch << std::endl;
-			if(print_summary){
-				std::ofstream out(exp_name + method + "_summary.txt");
-				cur_sch.sch->print_summary(out);
-			}
-			if(print_scheme){
-				std::ofstream out(exp_name + method + "_scheme.txt");
-				cur_sch.sch->print_scheme("", out);
-			}
-			if(print_tree){
-				std::ofstream out(exp_name + method + "_tree.txt");
-				cur_sch.sch->print_tree("", out);
-			}
-
-#ifndef NOT_GEN_IR
-			if(gen_IR){
-				auto IR = cur_sch.sch->IR_gen();
-				Json::StyledWriter swriter;
-				std::string curIRName = exp_name + method + "_IR.json";
-				std::ofstream IRfile(curIRName);
-				IRfile << swriter.write(IR);
-				IRfile.close();
-			}
-#endif
+			writer.write(method, cur_sch.sch, cur_sch.tree);
 			min_sch.min(cur_sch);
 		}else{
 			std::cout << method << " finds no valid solution." << std::endl;
@@ -392,68 +653,129 @@ int main(int argc, char** argv){
 			return init_sch;
 		}
 
-		WholeSch SA_sch;
-
-		std::thread* thr[tries];
-		WholeSch try_sch[tries];
-		for(int i = 0; i < tries; ++i){
-			try_sch[i] = init_sch.copy();
-			thr[i] = new std::thread(&SAEngine::SA_search, searchEngine[i], std::ref(try_sch[i]), std::ref(c), 0, 0);
-		}
-		for(int i = 0; i < tries; ++i){
-			thr[i]->join();
-			delete thr[i];
-			if(i != 0)
-				searchEngine[i]->flushBuf();
-			SA_sch.min(try_sch[i]);
-		}
+		WholeSch SA_sch = SET_search(searchEngine, tries, init_sch, c);
 		if(SA_sch){
 			std::cout << exp_name << method << ": " << SA_sch.sch << std::endl;
-			if(print_summary){
-				std::ofstream out(exp_name + method + "_summary.txt");
-				SA_sch.sch->print_summary(out);
-			}
-			if(print_scheme){
-				std::ofstream out(exp_name + method + "_scheme.txt");
-				SA_sch.sch->print_scheme("", out);
-			}
-			if(print_tree){
-				std::ofstream out(exp_name + method + "_tree.txt");
-				SA_sch.sch->print_tree("", out);
-			}
-
-#ifndef NOT_GEN_IR
-			if(gen_IR){
-				auto IR = SA_sch.sch->IR_gen();
-				Json::StyledWriter swriter;
-				std::string curIRName = exp_name + method + "_IR.json";
-				std::ofstream IRfile(curIRName);
-				IRfile << swriter.write(IR);
-				IRfile.close();
-			}
-#endif
+			writer.write(method, SA_sch.sch, SA_sch.tree);
 		}else{
 			std::cout << method << " finds no valid solution." << std::endl;
 		}
 		return SA_sch;
 	};
 
-	our_search("SET", init_sch).del();
+	// Only the stitcher needs the best RA Tree of SET and EVO.
+	auto keep_min = [&](WholeSch& w_sch){
+		if(stitcher){
+			min_sch.min(w_sch);
+		}else{
+			w_sch.del();
+		}
+	};
+
+	const WholeSch& SET_init = warm_sch ? warm_sch : (dp_sch ? dp_sch : init_sch);
+	WholeSch SET_sch = our_search("SET", SET_init);
+	keep_min(SET_sch);
+
+	// Evolutionary search, from the same starting point as SET.
+	if(evo_gens > 0){
+		EvoEngine evo(seed, MAX(std::thread::hardware_concurrency(), 1U));
+		WholeSch evo_sch = SET_init.copy();
+		evo.evo_search(evo_sch, c);
+		std::cout << exp_name << "EVO: " << evo_sch.sch << std::endl;
+		writer.write("EVO", evo_sch.sch, evo_sch.tree);
+		keep_min(evo_sch);
+	}
 	//our_search("SET-min", min_sch).del();
 
+	// Schedules the full network by the best RA Tree of the block network.
+	if(stitcher){
+		// Results of the block network are written before switching networks.
+		writer.wait();
+		network = full_net;
+		network->set_utime(*cMapper);
+		WholeSch full_sch = stitcher->stitch(min_sch, c);
+		if(full_sch){
+			std::cout << exp_name << "FULL: " << full_sch.sch << std::endl;
+			writer.write("FULL", full_sch.sch, full_sch.tree);
+		}else{
+			std::cout << "FULL finds no valid solution." << std::endl;
+		}
+		full_sch.del();
+	}
+
+	writer.wait();
+
 	init_sch.del();
+	warm_sch.del();
+	dp_sch.del();
 	min_sch.del();
 
 	for(int i=0; i<tries; ++i){
 		delete searchEngine[i];
 	}
 
+	close_db();
+
 	delete cMapper;
 	delete core;
 
 	return 0;
 }
 
+static WholeSch init_search(len_t tot_batch, const Cluster& c){
+	lid_t num_layer = network->len();
+	for(len_t lb = tot_batch; lb>0; lb/=2){
+		LTreeNode* init_tree = new LTreeNode(Bitset(), tot_batch, nullptr, LTreeNode::NodeType::T);
+		for(lid_t i = 0; i < num_layer; ++i){
+			(void)new LTreeNode(i, lb, init_tree);
+		}
+		init_tree->init_root();
+		SchNode* init_res = SchNode::newNode(init_tree, c, nullptr);
+		if(init_res->is_valid()){
+			init_tree->confirm();
+			return WholeSch(init_tree, init_res);
+		}
+		delete init_tree;
+		delete init_res;
+	}
+	return WholeSch();
+}
+
+static WholeSch load_search(std::istream& is, len_t tot_batch, const Cluster& c){
+	LTreeNode* tree = LTreeNode::load(is, tot_batch);
+	SchNode* res = nullptr;
+	if(tree){
+		res = SchNode::newNode(tree, c, nullptr);
+	}
+	if(res && res->is_valid()){
+		tree->confirm();
+		return WholeSch(tree, res);
+	}
+	delete tree;
+	delete res;
+	return WholeSch();
+}
+
+static WholeSch SET_search(SAEngine* const* engines, int tries, const WholeSch& init_sch, const Cluster& c){
+	WholeSch SA_sch;
+
+	std::vector<std::thread> thr;
+	std::vector<WholeSch> try_sch(tries);
+	for(int i = 0; i < tries; ++i){
+		try_sch[i] = init_sch.copy();
+	}
+	for(int i = 0; i < tries; ++i){
+		thr.emplace_back(&SAEngine::SA_search, engines[i], std::ref(try_sch[i]), std::ref(c), 0, 0);
+	}
+	for(int i = 0; i < tries; ++i){
+		thr[i].join();
+		if(i != 0)
+			engines[i]->flushBuf();
+		SA_sch.min(try_sch[i]);
+	}
+	return SA_sch;
+}
+
 static void init_core(const std::string& core_type, Core*& core, CoreMapper*& cMapper){
 	Core::numMac_t LR_mac_num = 64;
 	energy_t LR_mac_cost = 0.0873; //IEEE FP16
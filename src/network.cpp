@@ -1,7 +1,11 @@
 #include "network.h"
 
 #include <cassert>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
+#include <typeinfo>
+#include <utility>
 
 #include "coremapping.h"
 
@@ -18,10 +22,10 @@ const fmap_shape& InputData::get_shape() const{
 	return data_shape;
 }
 
-Node::Node(const Layer* _l, const Bitset& _ifmPrevs, len_t _external_C, bwidth_t width, const Bitset& _wgtPrevs)
-	:l(_l), ifmPrevs(_ifmPrevs), wgtPrevs(_wgtPrevs), prevs(_ifmPrevs | _wgtPrevs), external_C(_external_C)
+Node::Node(std::shared_ptr<const Layer> _l, const Bitset& _ifmPrevs, len_t _external_C, bwidth_t width, const Bitset& _wgtPrevs, len_t _external_wgt_H)
+	:l(std::move(_l)), ifmPrevs(_ifmPrevs), wgtPrevs(_wgtPrevs), prevs(_ifmPrevs | _wgtPrevs), external_C(_external_C), external_wgt_H(_external_wgt_H)
 {
-	if(width > 0) const_cast<Layer*>(_l)->set_bitwidth(width);
+	if(width > 0) const_cast<Layer*>(l.get())->set_bitwidth(width);
 }
 
 const Layer& Node::layer() const{
@@ -56,10 +60,18 @@ len_t Node::get_external_C() const{
 	return external_C;
 }
 
+len_t Node::get_external_wgt_H() const{
+	return external_wgt_H;
+}
+
 bool Node::hasWgtPrevs() const{
 	return wgtPrevs.count() > 0;
 }
 
+bool Node::hasFmapWgt() const{
+	return hasWgtPrevs() || external_wgt_H > 0;
+}
+
 void Node::add_next(lid_t l){
 	nexts.set(l);
 }
@@ -83,7 +95,7 @@ void Network::err_eltwise(const std::string& lname, const len_t from_C, const le
 	throw std::logic_error("Eltwise ifmap channel mismatch.");
 }
 
-lid_t Network::add(const Layer* l, const layer_set& ifmPrevs, bwidth_t width, std::vector<InputData> ext_data, const layer_set& wgtPrevs){
+lid_t Network::add(const Layer* l, const layer_set& ifmPrevs, bwidth_t width, std::vector<InputData> ext_data, const layer_set& wgtPrevs, std::vector<InputData> ext_wgt){
 	// If no prevs indicated, use default_bs.
 	bool default_prev = (ext_data.empty() && ifmPrevs.empty());
 	lid_t last_id = 0;
@@ -146,7 +158,31 @@ lid_t Network::add(const Layer* l, const layer_set& ifmPrevs, bwidth_t width, st
 	}
 
 	// Checks for weight prevs
-	if(prevWgts.count() > 0){
+	len_t external_wgt_H = 0;
+	if(IS_INSTANCE(l, MatMulLayer)){
+		// Rows of B: ext_wgt, then wgtPrevs.
+		fmap_shape wgtShape = l->weight_shape();
+		len_t curH = 0;
+		auto check_wgt = [&](const fmap_shape& in_shape){
+			if(in_shape.c != wgtShape.c || in_shape.w != wgtShape.w){
+				err_mismatch(l->get_name(), in_shape, wgtShape);
+			}
+			curH += in_shape.h;
+		};
+		for(const InputData& input : ext_wgt){
+			check_wgt(input.get_shape());
+		}
+		external_wgt_H = curH;
+		FOR_BITSET(it, prevWgts){
+			check_wgt(getNode(it).layer().ofmap_shape());
+		}
+
+		if(curH != wgtShape.h){
+			fmap_shape curShape = wgtShape;
+			curShape.h = curH;
+			err_mismatch(l->get_name(), curShape, wgtShape, true);
+		}
+	}else if(prevWgts.count() > 0){
 		assert(l->weight_size() > 0);
 		fmap_shape wgtShape = l->weight_shape();
 		len_t curC = 0;
@@ -166,6 +202,7 @@ lid_t Network::add(const Layer* l, const layer_set& ifmPrevs, bwidth_t width, st
 			err_mismatch(l->get_name(), curShape, wgtShape, true);
 		}
 	}
+	assert(ext_wgt.empty() || IS_INSTANCE(l, MatMulLayer));
 
 	if(layers.size() >= std::numeric_limits<lid_t>::max()){
 		throw std::overflow_error("Too many layers! Consider using a larger format for lid_t (perhaps uint32_t?)");
@@ -188,11 +225,95 @@ lid_t Network::add(const Layer* l, const layer_set& ifmPrevs, bwidth_t width, st
 	}
 
 	// Add layer to network
-	layers.emplace_back(l, prev_layers, external_C, width, prevWgts);
+	layers.emplace_back(std::shared_ptr<const Layer>(l), prev_layers, external_C, width, prevWgts, external_wgt_H);
+	add_shape_class();
 
 	return cur_id;
 }
 
+void Network::add_shape_class(){
+	std::string sig = last_signature();
+	shape_cls.push_back(sig_cls.emplace(sig, static_cast<lid_t>(layers.size()-1)).first->second);
+	shape_sigs.push_back(std::move(sig));
+}
+
+std::string Network::last_signature() const{
+	const Node& node = layers.back();
+	const Layer& l = node.layer();
+	std::ostringstream sig;
+	sig << typeid(l).name();
+	sig << ' ' << l.real_ifmap_shape() << l.tot_ifmap_shape() << l.ofmap_shape();
+	// Weight shape is not set in layers without weight.
+	if(l.weight_size() > 0) sig << l.weight_shape();
+	sig << ' ' << l.get_num_op();
+	// Kept out of the signature by default, thus old DB files stay valid.
+	if(l.has_bitwidth()) sig << " bits " << +l.get_bitwidth() << ' ' << +l.get_wgt_bitwidth();
+	if(l.has_sparsity()) sig << " sparse " << l.get_sparsity();
+
+	// Parameters not implied by the shapes.
+	auto add_params = [&](const Layer& cur){
+		if(REF_IS_INSTANCE(cur, ConvLayer)){
+			const auto& wl = static_cast<const ConvLayer&>(cur).get_workload();
+			sig << ' ' << wl.R << ' ' << wl.S << ' ' << wl.sH << ' ' << wl.sW;
+			if(REF_IS_INSTANCE(cur, GroupConvLayer)){
+				const auto& gwl = static_cast<const GroupConvLayer&>(cur).get_workload();
+				sig << ' ' << gwl.G << ' ' << gwl.GC << ' ' << gwl.GK;
+			}
+			if(REF_IS_INSTANCE(cur, MatMulLayer)){
+				sig << ' ' << static_cast<const MatMulLayer&>(cur).get_workload().transB;
+			}
+		}else{
+			const auto& wl = static_cast<const LRLayer&>(cur).get_workload();
+			sig << ' ' << wl.N << ' ' << wl.R << ' ' << wl.S << ' ' << wl.sK << ' ' << wl.sH << ' ' << wl.sW;
+			if(REF_IS_INSTANCE(cur, TransposeLayer)){
+				const auto& twl = static_cast<const TransposeLayer&>(cur).get_workload();
+				for(auto d : twl.order) sig << ' ' << static_cast<int>(d);
+			}
+		}
+	};
+	if(REF_IS_INSTANCE(l, FusedLayer)){
+		// The base layer, then each post layer.
+		const auto& fl = static_cast<const FusedLayer&>(l);
+		sig << ' ' << typeid(fl.get_base()).name();
+		add_params(fl.get_base());
+		for(const auto& post : fl.get_posts()){
+			sig << " + " << typeid(*post).name() << ' ' << post->ofmap_shape();
+			add_params(*post);
+		}
+	}else{
+		add_params(l);
+	}
+
+	// Prev structure: external channels, then channels of each prev (in order).
+	sig << " | " << node.get_external_C();
+	if(node.get_external_wgt_H() > 0) sig << " w" << node.get_external_wgt_H();
+	FOR_BITSET(it, node.getPrevs()){
+		const Layer& prev = getNode(it).layer();
+		sig << ' ' << (node.getWgtPrevs().contains(it) ? 'w' : 'i') << prev.ofmap_shape().c;
+		if(prev.has_bitwidth()) sig << 'b' << +prev.get_bitwidth();
+	}
+	return sig.str();
+}
+
+bwidth_t Network::ifm_bitwidth(lid_t id) const{
+	const Node& node = layers[id];
+	bwidth_t width = (node.get_external_C() > 0 || node.getIfmPrevs().count() == 0) ? node.layer().get_bitwidth() : 0;
+	FOR_BITSET(it, node.getIfmPrevs()){
+		width = MAX(width, layers[it].layer().get_bitwidth());
+	}
+	return width;
+}
+
+bwidth_t Network::wgt_bitwidth(lid_t id) const{
+	const Node& node = layers[id];
+	if(!node.hasFmapWgt()) return node.layer().get_wgt_bitwidth();
+	bwidth_t width = (node.get_external_wgt_H() > 0) ? node.layer().get_bitwidth() : 0;
+	FOR_BITSET(it, node.getWgtPrevs()){
+		width = MAX(width, layers[it].layer().get_bitwidth());
+	}
+	return width;
+}
+
 const Node& Network::getNode(lid_t id) const{
 	return layers[id];
 }
@@ -241,9 +362,134 @@ bool Network::has_dep(const Bitset& src, const Bitset& dst) const{
 	return false;
 }
 
+lid_t Network::shape_class(lid_t id) const{
+	return shape_cls[id];
+}
+
+const std::string& Network::shape_sig(lid_t id) const{
+	return shape_sigs[id];
+}
+
+lid_t Network::num_shape_classes() const{
+	return static_cast<lid_t>(sig_cls.size());
+}
+
+bool Network::find_blocks(lid_t& start, lid_t& period, lid_t& num) const{
+	const lid_t num_layer = len();
+	// Whether layer i+p is layer i shifted by p.
+	auto shifted = [&](lid_t i, lid_t p){
+		if(shape_cls[i] != shape_cls[i+p]) return false;
+		const Bitset& prevs = layers[i].getPrevs();
+		const Bitset& sh_prevs = layers[i+p].getPrevs();
+		if(prevs.count() != sh_prevs.count()) return false;
+		Bitset::bitlen_t sh = sh_prevs.first();
+		FOR_BITSET(it, prevs){
+			if(sh != it + p) return false;
+			sh = sh_prevs.next(sh);
+		}
+		return true;
+	};
+
+	// Covered layers (period * num), the smaller period is preferred.
+	lid_t best_cover = 0;
+	num = 0;
+	for(lid_t p = 1; p <= num_layer / 2; ++p){
+		lid_t run = 0;
+		for(lid_t i = 0; i + p <= num_layer; ++i){
+			if(i + p < num_layer && shifted(i, p)){
+				++run;
+				continue;
+			}
+			// Run of layers [i-run, i) matches, thus [i-run, i+p) has (run+p)/p blocks.
+			lid_t cur_num = (run + p) / p;
+			if(cur_num >= 2 && cur_num * p > best_cover){
+				best_cover = cur_num * p;
+				start = i - run;
+				period = p;
+				num = cur_num;
+			}
+			run = 0;
+		}
+	}
+	return num >= 2;
+}
+
+bool Network::can_fuse(lid_t id, const std::vector<std::vector<lid_t>>& groups, const std::vector<std::size_t>& group_of) const{
+	const Node& node = layers[id];
+	const Layer& l = node.layer();
+	if(!REF_IS_INSTANCE(l, PTPLayer) && !REF_IS_INSTANCE(l, PoolingLayer)) return false;
+	if(node.get_external_C() > 0 || node.getPrevs().count() != 1) return false;
+
+	// The prev is the last layer of its group (it has only one next), whose base should be a conv.
+	lid_t prev = node.getPrevs().first();
+	const Node& base = layers[groups[group_of[prev]].front()];
+	return REF_IS_INSTANCE(base.layer(), ConvLayer) && layers[prev].get_nexts().count() == 1;
+}
+
+Network Network::fuse() const{
+	// Layers of each node in the fused network, the first one is the base layer.
+	std::vector<std::vector<lid_t>> groups;
+	// Index in "groups" of each layer.
+	std::vector<std::size_t> group_of(layers.size());
+	for(lid_t i = 0; i < len(); ++i){
+		if(can_fuse(i, groups, group_of)){
+			group_of[i] = group_of[layers[i].getPrevs().first()];
+			groups[group_of[i]].push_back(i);
+		}else{
+			group_of[i] = groups.size();
+			groups.push_back({i});
+		}
+	}
+
+	// Nodes are ordered by their base layers. Each prev of a base layer
+	// is the last layer of its node (which has only one next if fused), thus it is added before.
+	Network n;
+	// Id in "n" of each layer.
+	std::vector<lid_t> new_id(layers.size());
+	for(const std::vector<lid_t>& group : groups){
+		const Node& base = layers[group.front()];
+		lid_t cur_id = n.len();
+
+		std::shared_ptr<const Layer> l = base.l;
+		if(group.size() > 1){
+			std::vector<std::shared_ptr<const LRLayer>> posts;
+			for(std::size_t i = 1; i < group.size(); ++i){
+				posts.push_back(std::static_pointer_cast<const LRLayer>(layers[group[i]].l));
+			}
+			l = std::make_shared<FusedLayer>(base.l, std::move(posts));
+		}
+
+		Bitset ifmPrevs, wgtPrevs;
+		FOR_BITSET(it, base.getIfmPrevs()){
+			ifmPrevs.set(new_id[it]);
+		}
+		FOR_BITSET(it, base.getWgtPrevs()){
+			wgtPrevs.set(new_id[it]);
+		}
+		Bitset prevs = ifmPrevs | wgtPrevs;
+		FOR_BITSET(it, prevs){
+			n.layers[it].add_next(cur_id);
+		}
+		n.layers.emplace_back(std::move(l), ifmPrevs, base.get_external_C(), 0, wgtPrevs, base.get_external_wgt_H());
+		n.add_shape_class();
+
+		for(lid_t i : group){
+			new_id[i] = cur_id;
+		}
+	}
+	return n;
+}
+
 void Network::set_utime(const CoreMapper& mapper) const{
-	for(const Node& n:layers){
-		Layer& l = const_cast<Layer&>(n.layer());
-		mapper.set_utime(l);
+	for(lid_t i = 0; i < len(); ++i){
+		Layer& l = const_cast<Layer&>(layers[i].layer());
+		lid_t cls = shape_cls[i];
+		if(cls == i){
+			mapper.set_utime(l);
+			// Zero weights are not computed.
+			if(l.weight_size() > 0 && !layers[i].hasFmapWgt()) l.set_utime(l.get_utime() * l.get_sparsity().get_density());
+		}else{
+			l.set_utime(layers[cls].layer().get_utime());
+		}
 	}
 }
@@ -3,8 +3,6 @@
 #include <cassert>
 
 
-typedef TransposeLayer::dim Ldims;
-
 static lid_t add_attention(
 		Network& n, const std::string& name,
 		len_t len, len_t numG, len_t gSize, len_t decode_len,
@@ -12,40 +10,25 @@ static lid_t add_attention(
 ){
 
 	lid_t Q, K, V, QK, QK_elt, QKV;
-	Network::layer_set Ks;
 	Q = n.add(NLAYER(name + "_Q", Conv, H=len, W=1, C=numG*gSize), {prev});
-
-	len_t kv_len;
-	if(decode_len == 0){
-		kv_len = len;
-		for(len_t i=0; i<numG; ++i){
-			n.add(NLAYER(name + "_K" + std::to_string(i), Conv, C=numG*gSize, K=gSize, H=len, W=1), {prev});
-			K = n.add(NLAYER(name + "_Kt" + std::to_string(i), Transpose, K=len, H=gSize, W=1, order[Ldims::C]=Ldims::H, order[Ldims::H]=Ldims::C));
-			Ks.push_back(K);
-		}
-		// K = n.add(NLAYER(name + "_K", PTP, K=numG*len, H=gSize, W=1), Ks);
-		V = n.add(NLAYER(name + "_V", Conv, C=numG*gSize, H=len, W=1), {prev});
-	}else{
+	K = n.add(NLAYER(name + "_K", Conv, H=len, W=1, C=numG*gSize), {prev});
+	V = n.add(NLAYER(name + "_V", Conv, H=len, W=1, C=numG*gSize), {prev});
+
+	// K and V of previous tokens (KV cache) are read by QK/QKV from DRAM,
+	// as the first rows of their weights.
+	len_t kv_len = len;
+	std::vector<InputData> extK, extV;
+	if(decode_len > 0){
 		assert(len == 1);
 		kv_len = len + decode_len;
-
-		InputData extK(name + "_Kext", fmap_shape(numG*decode_len, gSize, 1));
-		InputData extV(name + "_Vext", fmap_shape(decode_len, numG*gSize, 1));
-
-		for(len_t i=0; i<numG; ++i){
-			n.add(NLAYER(name + "_K" + std::to_string(i), Conv, C=numG*gSize, K=gSize, H=len, W=1), {prev});
-			K = n.add(NLAYER(name + "_Kt" + std::to_string(i), Transpose, K=len, H=gSize, W=1, order[Ldims::C]=Ldims::H, order[Ldims::H]=Ldims::C));
-			Ks.push_back(K);
-		}
-		K = n.add(NLAYER(name + "_K", PTP, K=numG*kv_len, H=gSize, W=1), Ks, 0, {extK});
-		Ks = {K};
-		V = n.add(NLAYER(name + "_V", Conv, C=numG*gSize, H=len, W=1), {prev});
-		V = n.add(NLAYER(name + "_Vt1", Transpose, K=len, H=numG*gSize, W=1, order[Ldims::C]=Ldims::H, order[Ldims::H]=Ldims::C), {V});
-		V = n.add(NLAYER(name + "_Vt2", Transpose, K=numG*gSize, H=kv_len, W=1, order[Ldims::C]=Ldims::H, order[Ldims::H]=Ldims::C), {V}, 0, {extV});
+		extK.emplace_back(name + "_Kext", fmap_shape(numG*gSize, decode_len, 1));
+		extV.emplace_back(name + "_Vext", fmap_shape(numG*gSize, decode_len, 1));
 	}
-	QK = n.add(NLAYER(name + "_QK", GroupConv, H=len, W=1, C=numG*gSize, K = numG*kv_len, G=numG), {Q}, 0, {}, Ks);
+
+	// Q*K^T, where K is stored as (numG*gSize)*kv_len.
+	QK = n.add(NLAYER(name + "_QK", MatMul, G=numG, M=len, L=gSize, N=kv_len, transB=true), {Q}, 0, {}, {K}, extK);
 	QK_elt = n.add(NLAYER(name + "_QK_elt", PTP, K=numG*kv_len, H=len, W=1), {QK});
-	QKV = n.add(NLAYER(name + "_QKV", GroupConv, H=len, W=1, C=numG*kv_len, K=numG*gSize, G=numG), {QK_elt}, 0, {}, {V});
+	QKV = n.add(NLAYER(name + "_QKV", MatMul, G=numG, M=len, L=kv_len, N=gSize), {QK_elt}, 0, {}, {V}, extV);
 	return n.add(NLAYER(name + "_FC", Conv, H=len, W=1, C=numG*gSize), {QKV});
 }
 
@@ -90,6 +73,10 @@ static Network create_transformer(
 	InputData input_layer("input_layer", fmap_shape(totG, curH, 1));
 	block_prev = n.add(NLAYER("word_embed", PTP, K=totG, H=curH, W=1), {}, 0, {input_layer});
 	for(len_t i=1; i<=nBlock; ++i){
+		// Returns an empty network if Bitset can't hold all layers.
+		if(i == 2 && (n.len() - 1) * static_cast<std::size_t>(nBlock) + 2 > Bitset::MAX_BITS){
+			return Network();
+		}
 		block_prev = add_trans_block(n, "block"+std::to_string(i), len, numG, gSize, ff_len, decode_len, block_prev);
 	}
 	n.add(NLAYER("proj", Conv, C=totG, K=vocab_len, H=curH, W=1), {block_prev});
@@ -101,9 +88,9 @@ static Network create_transformer(
  * and all blocks in the network are identical,
  * a single block is provided for each network.
  *
- * To run the full network, one can uncomment the networks below.
- * Also remember to uncomment in "nns/nns.h", add the network in "main.cpp",
- * and increase MAX_BITS_IN_BS in "bitset.h".
+ * The complete networks are only built if Bitset can hold all layers
+ * (BERT: 266, GPT2_prefill: 530, GPT2_decode: 530, which fit the default MAX_BITS).
+ * They are scheduled by searching the single block (see "blocks.h").
  */
 
 /*
@@ -114,7 +101,7 @@ static Network create_transformer(
  * nBlock     = 24
  * is_prefill = true
 */
-// const Network BERT = create_transformer(16, 64, 24, true);
+const Network BERT = create_transformer(16, 64, 24, true);
 const Network BERT_block = create_transformer(16, 64, 1, true);
 
 /*
@@ -125,7 +112,7 @@ const Network BERT_block = create_transformer(16, 64, 1, true);
  * nBlock     = 48
  * is_prefill = true
 */
-// const Network GPT2_prefill = create_transformer(25, 64, 48, true);
+const Network GPT2_prefill = create_transformer(25, 64, 48, true);
 const Network GPT2_prefill_block = create_transformer(25, 64, 1, true);
 
 /*
@@ -136,6 +123,14 @@ const Network GPT2_prefill_block = create_transformer(25, 64, 1, true);
  * nBlock     = 48
  * is_prefill = false
 */
-// const Network GPT2_decode = create_transformer(25, 64, 48, false);
+const Network GPT2_decode = create_transformer(25, 64, 48, false);
 const Network GPT2_decode_block = create_transformer(25, 64, 1, false);
 
+/*
+ * GPT2_decode_block with a KV cache of kv_len tokens (GPT2_decode_block has 512).
+ * The feed-forward length stays 4*512, thus only the attention layers change with kv_len.
+ */
+Network GPT2_decode_block_kv(len_t kv_len){
+	return create_transformer(25, 64, 1, false, 1000, kv_len, 4*512);
+}
+
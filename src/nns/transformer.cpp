@@ -1,8 +1,6 @@
 ﻿#include "nns/nns.h"
 
 
-typedef TransposeLayer::dim Ldims;
-
 static lid_t add_attention(
 		Network& n, const std::string& name,
 		len_t len, len_t numG, len_t gSize,
@@ -10,18 +8,13 @@ static lid_t add_attention(
 
 
 	lid_t Q, K, V, QK, QK_elt, QKV;
-	Network::layer_set Ks;
 	Q = n.add(NLAYER(name + "_Q", Conv, H=len, W=1, C=numG*gSize), {prevQ});
-	for(len_t i=0; i<numG; ++i){
-		n.add(NLAYER(name + "_K" + std::to_string(i), Conv, C=numG*gSize, K=gSize, H=len, W=1), {prevK});
-		K = n.add(NLAYER(name + "_Kt" + std::to_string(i), Transpose, K=len, H=gSize, W=1, order[Ldims::C]=Ldims::H, order[Ldims::H]=Ldims::C));
-		Ks.push_back(K);
-	}
-	K = n.add(NLAYER(name + "_K", PTP, K=numG*len, H=gSize, W=1), Ks);
-	V = n.add(NLAYER(name + "_V", Conv, C=numG*gSize, H=len, W=1), {prevV});
-	QK = n.add(NLAYER(name + "_QK", GroupConv, H=len, W=1, C=numG*gSize, K = numG*len, G=numG), {Q}, 0, {}, {K});
+	K = n.add(NLAYER(name + "_K", Conv, H=len, W=1, C=numG*gSize), {prevK});
+	V = n.add(NLAYER(name + "_V", Conv, H=len, W=1, C=numG*gSize), {prevV});
+	// Q*K^T, where K is stored as (numG*gSize)*len.
+	QK = n.add(NLAYER(name + "_QK", MatMul, G=numG, M=len, L=gSize, N=len, transB=true), {Q}, 0, {}, {K});
 	QK_elt = n.add(NLAYER(name + "_QK_elt", PTP, K=numG*len, H=len, W=1), {QK});
-	QKV = n.add(NLAYER(name + "_QKV", GroupConv, H=len, W=1, C=numG*len, K=numG*gSize, G=numG), {QK_elt}, 0, {}, {V});
+	QKV = n.add(NLAYER(name + "_QKV", MatMul, G=numG, M=len, L=len, N=gSize), {QK_elt}, 0, {}, {V});
 	return n.add(NLAYER(name + "_FC", Conv, H=len, W=1, C=numG*gSize), {QKV});
 }
 
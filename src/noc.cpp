@@ -25,9 +25,12 @@ NoC NoC::operator+(const NoC& other) const{
 NoC& NoC::operator+=(const NoC& other){
 	tot_hops += other.tot_hops;
 	tot_DRAM_acc += other.tot_DRAM_acc;
-	if(calc_bw || other.calc_bw){
-		assert(calc_bw && other.calc_bw);
+	if(calc_bw && other.calc_bw){
 		link_hops += other.link_hops;
+	}else if(calc_bw){
+		// Hops on each link of "other" are unknown.
+		calc_bw = false;
+		link_hops.clear();
 	}
 	return *this;
 }
@@ -98,7 +101,7 @@ void NoC::fromRemoteMem(const DataLayout& toLayout){
 	auto rLen = toLayout.rangeLength();
 	for(cidx_t i=0; i<rLen; ++i){
 		auto it = toLayout.at(i);
-		vol_t curSize = it.range.size();
+		vol_t curSize = toLayout.dataVol(it.range.size());
 		if(curSize <= 0) continue;
 		if(it.numTile == 1){
 			unicast_from_dram(it.tiles[0], curSize);
@@ -117,7 +120,26 @@ void NoC::fromRemoteMem(const DataLayout& toLayout, len_t fromC, len_t toC){
 		auto it = toLayout.at(i);
 		fmap_range range = it.range;
 		range.c = range.c.intersect(truncRange);
-		vol_t curSize = range.size();
+		vol_t curSize = toLayout.dataVol(range.size());
+		if(curSize <= 0) continue;
+		if(it.numTile == 1){
+			unicast_from_dram(it.tiles[0], curSize);
+		}else{
+			multicast_from_dram(it.tiles, it.numTile, curSize);
+		}
+	}
+}
+
+void NoC::fromRemoteMemH(const DataLayout& toLayout, len_t fromH, len_t toH){
+	if(toH <= fromH) return;
+	fmap_range::dim_range truncRange = {fromH, toH};
+
+	auto rLen = toLayout.rangeLength();
+	for(cidx_t i=0; i<rLen; ++i){
+		auto it = toLayout.at(i);
+		fmap_range range = it.range;
+		range.h = range.h.intersect(truncRange);
+		vol_t curSize = toLayout.dataVol(range.size());
 		if(curSize <= 0) continue;
 		if(it.numTile == 1){
 			unicast_from_dram(it.tiles[0], curSize);
@@ -130,13 +152,13 @@ void NoC::fromRemoteMem(const DataLayout& toLayout, len_t fromC, len_t toC){
 void NoC::toRemoteMem(const UniqueLayout& fromLayout){
 	for(cidx_t i=0; i<fromLayout.totLength(); ++i){
 		auto it = fromLayout[i];
-		vol_t curSize = it.range.size();
+		vol_t curSize = fromLayout.dataVol(it.range.size());
 		if(curSize <= 0) continue;
 		unicast_to_dram(it.tile, curSize);
 	}
 }
 
-void NoC::betweenLayout(const UniqueLayout& fromLayout, const DataLayout& toLayout, len_t fromCOffset, len_t fromB, len_t toB){
+void NoC::betweenLayout(const UniqueLayout& fromLayout, const DataLayout& toLayout, len_t fromCOffset, len_t fromB, len_t toB, len_t fromHOffset){
 	hop_t h = 0;
 
 	const auto* fLayout = dynamic_cast<const StdULayout*>(&fromLayout);
@@ -154,10 +176,14 @@ void NoC::betweenLayout(const UniqueLayout& fromLayout, const DataLayout& toLayo
 
 		if(toRange.c.to <= fromCOffset) continue;
 		toRange.c -= fromCOffset;
+		if(toRange.h.to <= fromHOffset) continue;
+		toRange.h.from = (toRange.h.from > fromHOffset) ? toRange.h.from - fromHOffset : 0;
+		toRange.h.to -= fromHOffset;
 
 		for(auto it = fLayout->get_intersect(toRange, diffB); it.isValid(); it.next()){
 			auto fromEntry = *it;
-			vol_t v = calc_intersect(fromEntry.range, toRange, fromB, toB);
+			// Data are sent in the bitwidth of the producer.
+			vol_t v = fromLayout.dataVol(calc_intersect(fromEntry.range, toRange, fromB, toB));
 			if(v == 0) continue;
 
 			if(toEntry.numTile == 1){
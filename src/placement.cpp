@@ -82,6 +82,12 @@ void PlaceSch::finalize(){
 	permuteOrder.reset();
 }
 
+bool PlaceSch::operator==(const PlaceSch& other) const{
+	if(part.K != other.part.K || part.B != other.part.B) return false;
+	if(part.H != other.part.H || part.W != other.part.W) return false;
+	return memcmp(order, other.order, sizeof(order[0])*4) == 0;
+}
+
 std::ostream& operator<<(std::ostream& os, const PlaceSch& sch){
 	os << '(';
 	for(int i=0;i<4;++i){
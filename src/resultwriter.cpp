@@ -0,0 +1,120 @@
+#include "resultwriter.h"
+
+#include <fstream>
+#include <memory>
+
+#include "ltreenode.h"
+#include "schnode.h"
+#include "simulator.h"
+
+#ifndef NOT_GEN_IR
+#include "json/json.h"
+#endif
+
+
+ResultWriter::ResultWriter(const std::string& _prefix, unsigned num_threads)
+	:prefix(_prefix), num_pending(0), stopping(false),
+	 print_summary(true), print_scheme(true), print_tree(true)
+#ifndef NOT_GEN_IR
+	 , gen_IR(true), sim_IR(false)
+#endif
+{
+	num_threads = MAX(num_threads, 1U);
+	for(unsigned i = 0; i < num_threads; ++i){
+		workers.emplace_back(&ResultWriter::work, this);
+	}
+}
+
+ResultWriter::~ResultWriter(){
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	job_cv.notify_all();
+	for(auto& thr : workers){
+		thr.join();
+	}
+}
+
+void ResultWriter::work(){
+	while(true){
+		job_t job;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			job_cv.wait(lock, [this]{return stopping || !jobs.empty();});
+			// Remaining jobs are still done when stopping.
+			if(jobs.empty()) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			--num_pending;
+		}
+		done_cv.notify_all();
+	}
+}
+
+void ResultWriter::push(job_t&& job){
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		jobs.push_back(std::move(job));
+		++num_pending;
+	}
+	job_cv.notify_one();
+}
+
+void ResultWriter::wait(){
+	std::unique_lock<std::mutex> lock(mtx);
+	done_cv.wait(lock, [this]{return num_pending == 0;});
+}
+
+void ResultWriter::write(const std::string& method, const SchNode* sch, const LTreeNode* tree, bool with_IR){
+	// Snapshots shared by all jobs of this result.
+	std::shared_ptr<const SchNode> sch_copy(sch->copy());
+	std::shared_ptr<const LTreeNode> tree_copy(tree->copy());
+	std::string name = prefix + method;
+
+	if(print_summary || print_scheme || print_tree){
+		bool summary = print_summary, scheme = print_scheme, tree_file = print_tree;
+		push([=]{
+			if(summary){
+				std::ofstream out(name + "_summary.txt");
+				sch_copy->print_summary(out);
+			}
+			if(scheme){
+				std::ofstream out(name + "_scheme.txt");
+				sch_copy->print_scheme("", out);
+			}
+			if(tree_file){
+				std::ofstream out(name + "_tree.txt");
+				sch_copy->print_tree("", out);
+				std::ofstream tree_out(name + "_ratree.txt");
+				tree_copy->save(tree_out);
+			}
+		});
+	}
+
+#ifndef NOT_GEN_IR
+	if(with_IR && gen_IR){
+		bool sim = sim_IR;
+		push([=]{
+			auto IR = sch_copy->IR_gen();
+			{
+				Json::StyledWriter swriter;
+				std::ofstream IRfile(name + "_IR.json");
+				IRfile << swriter.write(IR);
+			}
+			if(sim){
+				Simulator simulator(IR);
+				simulator.run();
+				std::ofstream simFile(name + "_sim.txt");
+				simulator.print_report(sch_copy->get_cost().time, simFile);
+			}
+		});
+	}
+#else
+	(void) with_IR;
+#endif
+}
@@ -11,8 +11,11 @@
 #include <stdexcept>	// std::invalid_argument
 
 #include "bitset.h"		// Bitset
+#include "cooling.h"	// CoolingSchedule
 #include "network.h"	// network
+#include "schcache.h"	// SchCache
 #include "schnode.h"	// SchNode, LTreeNode
+#include "transtable.h"	// TransTable
 
 /*
 #include <chrono>		// std::chrono
@@ -44,6 +47,7 @@ void WholeSch::del(){
 	}
 }
 void WholeSch::min(WholeSch& w_sch){
+	if(!w_sch) return;
 	if(!tree){
 		tree = w_sch.tree;
 		sch = w_sch.sch;
@@ -70,24 +74,124 @@ namespace {
 }
 
 int SAEngine::nrounds;
-
-void SAEngine::halv_bat(LTreeNode* node){
+bool SAEngine::adaptive_op = false;
+std::string SAEngine::cooling_name = "fixed";
+LayerEngine* SAEngine::approx_engine = nullptr;
+const int SAEngine::op_weight[NUM_OP] = {10,10,20,20,20,20,40};
+std::size_t SAEngine::cache_size = 0;
+int SAEngine::table_mode = 1;
+TransTable SAEngine::shared_table(true);
+
+void SAEngine::halv_bat(LTreeNode* node, UndoLog& log){
 	if(!node->children.empty() && node->children.front()->num_batch == node->num_batch){
 		for(auto x : node->children){
-			halv_bat(x);
+			halv_bat(x, log);
 		}
 	}
+	log.save(node);
 	node->num_batch /= 2;
 }
 
-void SAEngine::flat_bat(LTreeNode* node, len_t n_batch){
+void SAEngine::flat_bat(LTreeNode* node, UndoLog& log, len_t n_batch){
 	if(node->num_batch <= n_batch) return;
 	for(auto x : node->children){
-		flat_bat(x, n_batch);
+		flat_bat(x, log, n_batch);
 	}
+	log.save(node);
 	node->num_batch = n_batch;
 }
 
+SchNode* SAEngine::schedule(LTreeNode* tree, const SchNode* cur_res, const Cluster& c){
+	// Layers in new segments are only re-searched if their conditions changed.
+	SchNode::setReuse(cur_res);
+	SchNode* new_res;
+	if(tree->isNew()){
+		new_res = SchNode::newNode(tree, c, nullptr);
+	}else{
+		new_res = cur_res->copy();
+		assert(tree->isModified());
+		// Use incremental search
+		new_res->searchInc(tree);
+	}
+	SchNode::setReuse(nullptr);
+	return new_res;
+}
+
+SchNode* SAEngine::schedule_approx(LTreeNode* tree, const SchNode* cur_approx, const Cluster& c){
+	// Cached subtrees are scheduled exactly, thus can't be used here.
+	SchNode::setCache(nullptr);
+	SchNode::setMapper(approx_engine);
+	SchNode* new_res;
+	if(cur_approx == nullptr || !cur_approx->is_valid()){
+		new_res = SchNode::newNode(tree, c, nullptr);
+	}else{
+		new_res = schedule(tree, cur_approx, c);
+	}
+	SchNode::setMapper(nullptr);
+	SchNode::setCache(cache);
+	return new_res;
+}
+
+int SAEngine::pick_op(const bool* valid_op){
+	int t;
+	if(!adaptive_op){
+		int prob[NUM_OP];
+		prob[0] = op_weight[0];
+		for(int i=1; i<NUM_OP; ++i){
+			prob[i] = prob[i-1] + op_weight[i];
+		}
+		do{
+			int pr = randInt(prob[NUM_OP-1]);
+			t=0;
+			while(pr >= prob[t]) ++t;
+		}while(!valid_op[t]);
+		return t;
+	}
+
+	double prob[NUM_OP];
+	op_prob(valid_op, prob);
+	double pr = std::uniform_real_distribution(0.0, 1.0)(generator);
+	int last_valid = 0;
+	for(t=0; t<NUM_OP; ++t){
+		if(!valid_op[t]) continue;
+		last_valid = t;
+		pr -= prob[t];
+		if(pr < 0) return t;
+	}
+	// Only reached by rounding errors.
+	return last_valid;
+}
+
+void SAEngine::op_prob(const bool* valid_op, double* prob) const{
+	int num_valid = 0;
+	double tot_weight = 0, tot_reward = 0;
+	for(int i=0; i<NUM_OP; ++i){
+		if(!valid_op[i]) continue;
+		++num_valid;
+		tot_weight += op_weight[i];
+		tot_reward += op_reward[i];
+	}
+
+	/*
+	 * Probability matching:
+	 * op_explore is shared equally, the rest is proportional to the average reward.
+	 * Uses the fixed weights before any OP is rewarded.
+	 */
+	for(int i=0; i<NUM_OP; ++i){
+		if(!valid_op[i]){
+			prob[i] = 0;
+		}else if(tot_reward <= 0){
+			prob[i] = op_weight[i] / tot_weight;
+		}else{
+			prob[i] = op_explore / num_valid + (1 - op_explore) * op_reward[i] / tot_reward;
+		}
+	}
+}
+
+void SAEngine::update_op(int op, double reward){
+	op_reward[op] += op_decay * (reward - op_reward[op]);
+}
+
 int SAEngine::randInt(int to){
 	return std::uniform_int_distribution(0, to-1)(generator);
 }
@@ -115,9 +219,15 @@ void SAEngine::ping_func(volatile bool& stop) const{
 
 
 SAEngine::SAEngine(std::uint32_t seed, bool directCout)
-	:generator(seed), out(directCout ? std::cout : strStream)
+	:generator(seed), cache(new SchCache(cache_size)), cooling(nullptr), out(directCout ? std::cout : strStream)
 {
 	strStream.precision(4);
+	// Also used by sa_change() outside SA_search.
+	for(int i=0; i<NUM_OP; ++i) op_reward[i] = 0;
+}
+
+SAEngine::~SAEngine(){
+	delete cache;
 }
 
 void SAEngine::flushBuf(){
@@ -126,6 +236,10 @@ void SAEngine::flushBuf(){
 	strStream.str("");
 }
 
+void SAEngine::clear_shared(){
+	shared_table.clear();
+}
+
 void SAEngine::SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth, int sa_type){
 	time_t start_time = std::time(nullptr);
 
@@ -133,11 +247,16 @@ void SAEngine::SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth, int
 	LTreeNode*& min_node = w_sch.tree;
 	SchNode*& min_res = w_sch.sch;
 
-	// Current RA Tree
-	LTreeNode* cur_node = w_sch.tree;
-	SchNode* cur_res = w_sch.sch;
+	// Current RA Tree, never shared with min_node/min_res.
+	// cur_node is changed in place by sa_change(), and rolled back by "log" if rejected.
+	LTreeNode* cur_node = min_node->copy();
+	SchNode* cur_res = min_res->copy();
+	// Whether current RA Tree is the same as the minimal one.
+	bool cur_is_min = true;
+	UndoLog log;
+	cooling = CoolingSchedule::newSchedule(cooling_name, nrounds);
 
-	int print_intv = nrounds/30;
+	int print_intv = MAX(nrounds/30, 1);
 
 	int nvalid = 0, naccept = 0;
 	std::map<int, int> accept_num;
@@ -154,6 +273,7 @@ void SAEngine::SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth, int
 	for(int i=0; i<NUM_OP; ++i) valid_op[i] = true;
 	if(network->is_chain()) valid_op[0] = valid_op[1] = false;
 	if(cur_node->get_tot_batch() == 1) valid_op[4] = valid_op[5] = false;
+	for(int i=0; i<NUM_OP; ++i) op_reward[i] = 0;
 
 	num_tries = 0;
 	cur_tries = 0;
@@ -162,6 +282,28 @@ void SAEngine::SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth, int
 	// bool stop_ping = false;
 	// std::thread ping(ping_func, ref(stop_ping));
 
+	SchNode::setCache(cache);
+
+	// Transposition table of this search.
+	TransTable local_table(false);
+	TransTable* table = nullptr;
+	if(table_mode == 1) table = &local_table;
+	else if(table_mode == 2) table = &shared_table;
+	int ntable_hit = 0;
+	// Number of known RA Trees whose entry differs when scheduled again.
+	int ntable_stale = 0;
+	// Number of RA Trees rejected by SchNode::quick_check().
+	int nquick_fail = 0;
+
+	// Approximate scheme of cur_node, only used with approx_engine.
+	SchNode* cur_approx = nullptr;
+	if(approx_engine != nullptr) cur_approx = schedule_approx(cur_node, nullptr, c);
+	auto approx_cost = [](const SchNode* res){
+		return res->is_valid() ? res->get_cost().cost() : cost_inf;
+	};
+	// Number of RA Trees rejected under the approximate cost.
+	int nscreened = 0;
+
 	for(; cur_round<nrounds; ++cur_round){
 		// Prints each *print_intv* rounds.
 		if((cur_round+1) % print_intv == 0){
@@ -174,78 +316,155 @@ void SAEngine::SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth, int
 		// Change to best scheme in the last 10% rounds.
 		if(cur_round >= 0.90*nrounds && !using_best){
 			using_best = true;
-			if(cur_node != min_node){
+			if(!cur_is_min){
 				// std::unique_lock<std::mutex> l(m);
 				out << "Switch to best solution." << std::endl;
 				// l.unlock();
 				delete cur_node;
 				delete cur_res;
-				cur_node = min_node;
-				cur_res = min_res;
+				cur_node = min_node->copy();
+				cur_res = min_res->copy();
+				cur_is_min = true;
+				if(approx_engine != nullptr){
+					delete cur_approx;
+					cur_approx = schedule_approx(cur_node, nullptr, c);
+				}
 			}
 		}
 
 		// Mutate to a new RA Tree.
-		LTreeNode* new_tree = sa_change(cur_node, valid_op, max_depth, sa_type, &op_type);
+		sa_change(cur_node, log, valid_op, max_depth, sa_type, &op_type);
+		std::uint64_t num_search = SchNode::getSearchCount();
+
+		// Look up the new RA Tree in the transposition table.
+		TransTable::fp_t fp;
+		TransTable::Entry entry;
+		bool known = false;
+		if(table != nullptr){
+			fp = TransTable::fingerprint(cur_node, c);
+			known = table->find(fp, entry);
+			ntable_hit += known;
+		}
 
-		// Schedule the new RA Tree.
-		SchNode* new_res;
-		if(new_tree->isNew()){
-			new_res = SchNode::newNode(new_tree, c, nullptr);
-		}else{
-			new_res = cur_res->copy();
-			assert(new_tree->isModified());
-			// Use incremental search
-			new_res->searchInc(new_tree);
+		// Schedule the new RA Tree, if it is not known and passes the quick check.
+		SchNode* new_res = nullptr;
+		SchNode* new_approx = nullptr;
+		if(!known){
+			bool passed = SchNode::quick_check(cur_node, c);
+			if(!passed) ++nquick_fail;
+
+			// Screen by the approximate cost, which is not exact thus not recorded in table.
+			if(passed && approx_engine != nullptr){
+				new_approx = schedule_approx(cur_node, cur_approx, c);
+				if(!sa_accept(approx_cost(cur_approx), approx_cost(new_approx), cur_round)){
+					++nscreened;
+					if(adaptive_op) update_op(op_type, 0);
+					delete new_approx;
+					log.rollback(cur_node);
+					continue;
+				}
+			}
+
+			if(passed){
+				new_res = schedule(cur_node, cur_res, c);
+				entry.valid = new_res->is_valid();
+				entry.cost = new_res->get_cost();
+			}else{
+				entry.valid = false;
+			}
+			if(table != nullptr) table->add(fp, entry);
 		}
 
 		// If new RA Tree not valid, drop it.
-		if(!new_res->is_valid()){
-			delete new_tree;
+		if(!entry.valid){
+			if(adaptive_op) update_op(op_type, 0);
 			delete new_res;
+			delete new_approx;
+			log.rollback(cur_node);
 			continue;
 		}
 
-		new_tree->confirm();
+		cost_t new_cost = entry.cost.cost();
+		bool new_min = (new_cost < min_res->get_cost().cost());
+		cost_t cur_cost = cur_res->get_cost().cost();
+		bool accepted = sa_accept(cur_cost, new_cost, cur_round);
+
+		// A known RA Tree is only scheduled again when kept.
+		if(new_res == nullptr && (new_min || accepted)){
+			new_res = schedule(cur_node, cur_res, c);
+			// The table entry may be off (a fingerprint collision, or reused schemes
+			// rounding differently), then the entry is corrected and SA goes on
+			// with the real cost (the tree is dropped only if it is invalid).
+			if(!new_res->is_valid() || new_res->get_cost().cost() != new_cost){
+				entry.valid = new_res->is_valid();
+				entry.cost = new_res->get_cost();
+				table->add(fp, entry);
+				++ntable_stale;
+				if(!entry.valid){
+					if(adaptive_op) update_op(op_type, 0);
+					delete new_res;
+					delete new_approx;
+					log.rollback(cur_node);
+					continue;
+				}
+				new_cost = entry.cost.cost();
+				new_min = (new_cost < min_res->get_cost().cost());
+				accepted = sa_accept(cur_cost, new_cost, cur_round);
+			}
+		}
+		cooling->update(cur_round / static_cast<double>(nrounds), (new_cost - cur_cost) / cur_cost, accepted, new_min);
+		// The approximate scheme is kept with the current RA Tree.
+		if(approx_engine != nullptr && new_approx == nullptr && accepted){
+			new_approx = schedule_approx(cur_node, cur_approx, c);
+		}
+
+		// Reward of the OP: relative improvement per layer search.
+		if(adaptive_op){
+			double gain = MAX((cur_cost - new_cost) / cur_cost, 0.0);
+			update_op(op_type, gain / (1 + SchNode::getSearchCount() - num_search));
+		}
+
+		cur_node->confirm();
 		++nvalid;
 		++valid_num[op_type];
 
 		// Updates min_node/min_res
-		cost_t new_cost = new_res->get_cost().cost();
-		if(new_cost < min_res->get_cost().cost()){
-			if(cur_node != min_node){
-				delete min_node;
-				delete min_res;
-			}
-			min_node = new_tree;
-			min_res = new_res;
+		if(new_min){
+			delete min_node;
+			delete min_res;
+			min_node = cur_node->copy();
+			min_res = new_res->copy();
 		}
 
-		if(sa_accept(cur_res->get_cost().cost(), new_cost, cur_round)){
+		if(accepted){
 			// Accepted!
-			if(cur_node != min_node){
-				delete cur_node;
-				delete cur_res;
-			}
-			cur_node = new_tree;
+			log.commit();
+			delete cur_res;
 			cur_res = new_res;
+			cur_is_min = new_min;
+			if(approx_engine != nullptr){
+				delete cur_approx;
+				cur_approx = new_approx;
+			}
 			++naccept;
 			++accept_num[op_type];
 		}else{
 			// Rejected!
-			if(new_tree != min_node){
-				delete new_tree;
-				delete new_res;
-			}
+			delete new_res;
+			delete new_approx;
+			log.rollback(cur_node);
 		}
 	}
 
 	// SA finished...
 
-	if(cur_node != min_node){
-		delete cur_node;
-		delete cur_res;
-	}
+	delete cur_node;
+	delete cur_res;
+	delete cur_approx;
+
+	SchNode::setCache(nullptr);
+	delete cooling;
+	cooling = nullptr;
 
 	time_t end_time = std::time(nullptr);
 
@@ -254,30 +473,42 @@ void SAEngine::SA_search(WholeSch& w_sch, const Cluster& c, lid_t max_depth, int
 
 	out << "Elapsed: " << end_time - start_time << "s ";
 	out << "Valid: " << nvalid << " (" << (nvalid*100.0)/nrounds << "%) ";
-	out << "Accept: " << naccept << " (" << (naccept*100.0)/nrounds << "%)" << std::endl;
+	out << "Accept: " << naccept << " (" << (naccept*100.0)/nrounds << "%) ";
+	out << "Quick check failed: " << nquick_fail << " (" << (nquick_fail*100.0)/nrounds << "%)";
+	if(approx_engine != nullptr){
+		out << " Screened: " << nscreened << " (" << (nscreened*100.0)/nrounds << "%)";
+	}
+	out << std::endl;
 	out << "Per OP: ";
 	for(int i=0;i<NUM_OP;++i){
 		if(i>0) out << ", ";
 		out << accept_num[i] << '/' << valid_num[i];
 	}
 	out << std::endl;
+	if(adaptive_op){
+		double prob[NUM_OP];
+		op_prob(valid_op, prob);
+		out << "OP prob: ";
+		for(int i=0;i<NUM_OP;++i){
+			if(i>0) out << ", ";
+			out << prob[i];
+		}
+		out << std::endl;
+	}
+	if(table != nullptr){
+		out << "Transposition table: hit " << ntable_hit << '/' << nrounds << ", stale " << ntable_stale << std::endl;
+	}
+	cache->print_stats(out);
 }
 
 // sa_type: 0 -> arbitrary. 1 -> only s under top t. 2 -> only t under top t.
-LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth, int sa_type, int* op_type){
-	root = root->copy();
-
+void SAEngine::sa_change(LTreeNode* root, UndoLog& log, bool* valid_op, lid_t max_depth, int sa_type, int* op_type){
 	lid_t lnum = root->layers().count();
 	if(max_depth == 0) max_depth = lnum;
 	if(root->height > max_depth){
 		throw std::invalid_argument("The root of SA is deeper than max_depth!");
 	}
 
-	int prob[NUM_OP] = {10,10,20,20,20,20,40};
-	for(int i=1; i<NUM_OP; ++i){
-		prob[i] += prob[i-1];
-	}
-
 	// bool x[NUM_OP+1];
 	// std::memset(x,0,NUM_OP);
 
@@ -310,11 +541,7 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 		// Pick a random OP (in t)
 		ok=false;
-		do{
-			int pr = randInt(prob[NUM_OP-1]);
-			t=0;
-			while(pr >= prob[t]) ++t;
-		}while(!valid_op[t]);
+		t = pick_op(valid_op);
 
 		// if(x[t]) continue;
 
@@ -346,10 +573,12 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Found valid front, change!
 
+			log.save(front);
 			front->stage.clear();
 
 			// Reset path to lcl
 			while(lcl!=lnode){
+				log.save(lcl);
 				lcl->layer_set.reset(l);
 				lcl->layer_set.set(x);
 				lcl->stage.clear();
@@ -363,6 +592,7 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Reset path to lcc
 			while(lcc!=c){
+				log.save(lcc);
 				lcc->layer_set.reset(x);
 				lcc->layer_set.set(l);
 				lcc->stage.clear();
@@ -370,6 +600,10 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 			}
 
 			// Swap LNodes
+			log.save(c->parent);
+			log.save(lnode->parent);
+			log.save(c);
+			log.save(lnode);
 			auto i = find(c->parent->children, c);
 			auto j = find(lnode->parent->children, lnode);
 			c->parent->children[i] = lnode;
@@ -379,10 +613,13 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Now we'll reset the whole seg.
 			if(front == root){
+				log.save(front->children[k]);
+				log.save(front->children[k-1]);
 				front->children[k]->isNewNode = true;
 				front->children[k-1]->isNewNode = true;
 			}else{
 				while(front->parent->parent) front = front->parent;
+				log.save(front);
 				front->isNewNode = true;
 			}
 
@@ -414,10 +651,12 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Found valid back, change!
 
+			log.save(back);
 			back->stage.clear();
 
 			// Reset path to lcl
 			while(lcl!=lnode){
+				log.save(lcl);
 				lcl->layer_set.reset(l);
 				lcl->layer_set.set(x);
 				lcl->stage.clear();
@@ -431,6 +670,7 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Reset path to lcc
 			while(lcc!=c){
+				log.save(lcc);
 				lcc->layer_set.reset(x);
 				lcc->layer_set.set(l);
 				lcc->stage.clear();
@@ -438,6 +678,10 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 			}
 
 			// Swap LNodes
+			log.save(c->parent);
+			log.save(lnode->parent);
+			log.save(c);
+			log.save(lnode);
 			auto i = find(c->parent->children, c);
 			auto j = find(lnode->parent->children, lnode);
 			c->parent->children[i] = lnode;
@@ -447,10 +691,13 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Now we'll reset the whole seg.
 			if(back == root){
+				log.save(back->children[k]);
+				log.save(back->children[k+1]);
 				back->children[k]->isNewNode = true;
 				back->children[k+1]->isNewNode = true;
 			}else{
 				while(back->parent->parent) back = back->parent;
+				log.save(back);
 				back->isNewNode = true;
 			}
 
@@ -464,11 +711,15 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 			LTreeNode* grandma = par->parent;
 			if(grandma == nullptr) break;
 
+			log.save(grandma);
+			log.save(par);
 			auto i = find(grandma->children, par);
 			grandma->children.erase(grandma->children.begin()+i);
 			grandma->children.insert(grandma->children.begin()+i, par->children.begin(), par->children.end());
 			grandma->stage.clear();
 			for(auto x : par->children){
+				// Types in the subtree of x will be re-calculated.
+				log.save_subtree(x);
 				x->parent = grandma;
 				x->t = LTreeNode::NodeType::L;
 				x->num_batch = par->num_batch;
@@ -481,10 +732,11 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 				}
 			}else{
 				while(grandma->parent->parent) grandma = grandma->parent;
+				log.save(grandma);
 				grandma->isNewNode = true;
 			}
 			par->children.clear();
-			delete par;
+			log.add_removed(par);
 
 			ok=true;
 		}break;
@@ -518,6 +770,7 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 				if(p) break;
 			}
 
+			log.save(par);
 			par->stage.clear();
 			LTreeNode* new_par;
 
@@ -533,18 +786,22 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// If T_under_T, fix type to T; otherwise, auto decide type (set to default value L)
 			new_par=new LTreeNode(Bitset(),lnode->num_batch,nullptr, T_under_T ? LTreeNode::NodeType::T : LTreeNode::NodeType::L);
+			log.add_created(new_par);
 			new_par->children.insert(new_par->children.begin(), par->children.begin()+i, par->children.begin()+j);
 			new_par->parent = par;
 			par->children.erase(par->children.begin()+i, par->children.begin()+j);
 			par->children.insert(par->children.begin()+i, new_par);
 			for(auto x : new_par->children){
+				// Types in the subtree of x will be re-calculated.
+				log.save_subtree(x);
 				x->parent = new_par;
 				if(T_under_T) x->t = LTreeNode::NodeType::L;
-				else if(par->t == LTreeNode::NodeType::T) flat_bat(x);
+				else if(par->t == LTreeNode::NodeType::T) flat_bat(x, log);
 			}
 
 			// Now we'll reset the whole seg.
 			while(new_par->parent->parent) new_par = new_par->parent;
+			log.save(new_par);
 			new_par->isNewNode = true;
 
 			ok=true;
@@ -567,16 +824,16 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Mult batch by 2.
 			for(auto x:cur->children){
+				log.save(x);
 				x->num_batch *= 2;
 			}
 
 			// Now we'll reset the whole seg.
-			if(cur == root){
-				cur->isNewNode = true;
-			}else{
+			if(cur != root){
 				while(cur->parent->parent) cur = cur->parent;
-				cur->isNewNode = true;
 			}
+			log.save(cur);
+			cur->isNewNode = true;
 
 			ok=true;
 		}break;
@@ -598,16 +855,15 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 			// Divide batch by 2.
 			for(auto x:cur->children){
-				halv_bat(x);
+				halv_bat(x, log);
 			}
 
 			// Now we'll reset the whole seg.
-			if(cur == root){
-				cur->isNewNode = true;
-			}else{
+			if(cur != root){
 				while(cur->parent->parent) cur = cur->parent;
-				cur->isNewNode = true;
 			}
+			log.save(cur);
+			cur->isNewNode = true;
 
 			ok=true;
 		}break;
@@ -625,6 +881,9 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 				if(cut->t == LTreeNode::NodeType::L) break;
 
 				// Put lnode under cut.
+				log.save(par);
+				log.save(cut);
+				log.save(lnode);
 				par->stage.clear();
 				cut->stage.clear();
 				par->children.erase(par->children.begin()+node_pos);
@@ -640,6 +899,7 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 				// Now we'll reset the whole seg.
 				assert(cut != root);
 				while(cut->parent->parent) cut = cut->parent;
+				log.save(cut);
 				cut->isNewNode = true;
 			}else{
 				LTreeNode* grandma = par->parent;
@@ -648,6 +908,9 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 				// Put lnode under par->parent.
 				auto par_pos = find(grandma->children, par);
 				auto insert_pos = par_pos + (put_before ? 0 : 1);
+				log.save(par);
+				log.save(grandma);
+				log.save(lnode);
 				par->stage.clear();
 				grandma->stage.clear();
 				par->children.erase(par->children.begin()+node_pos);
@@ -662,6 +925,7 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 					par->isNewNode = true;
 				}else{
 					while(grandma->parent->parent) grandma = grandma->parent;
+					log.save(grandma);
 					grandma->isNewNode = true;
 				}
 			}
@@ -684,105 +948,14 @@ LTreeNode* SAEngine::sa_change(LTreeNode* root, bool* valid_op, lid_t max_depth,
 
 	// Initialize the RA Tree
 	root->init_root();
-
-	return root;
 }
 
 bool SAEngine::sa_accept(cost_t cur_cost, cost_t new_cost, int round){
 	if(new_cost <= cur_cost) return true;
-	/*
-	 * T(x) = a+c/(b+x)
-	 *
-	 * want:
-	 * a + c/b = 0.1
-	 * a + c/(b+0.5) = 0.01
-	 * a + c/(b+1) = 0
-	 *
-	 * thus:
-	 * a = -1 / 80
-	 * b = 0.01*0.5/(0.1*0.5-0.01) = 0.125
-	 * c = 9 / 640
-	 * T(x) = 1/10 * (1-x)/(1+8x)
-	 */
 	double x = round;
 	x /= nrounds;
-	// Since only 1/100 are good, multiply T by 0.7:
-	double T = 0.07 * (1-x)/(1+8*x);
+	double T = cooling->temperature(x);
 	double prob = std::exp(-((new_cost - cur_cost)/cur_cost)/T);
 	return withProb(prob);
 }
 
-
-// [Deprecated]
-void LP_search(lid_t num_layer, len_t tot_batch, Cluster& c, WholeSch& w_sch, bool has_S, bool has_T){
-	if(!has_S && !has_T){
-		throw std::invalid_argument("Either has_S or has_T must be true.");
-	}
-	LTreeNode*& tree_node = w_sch.tree;
-	SchNode*& sch_res = w_sch.sch;
-	SchNode::SchCost LP_cost;
-	LTreeNode** LP_DP = new LTreeNode*[num_layer];
-	SchNode* tmp = nullptr;
-	SchNode* last = nullptr;
-	LTreeNode* root_Node;
-	for(int i=0;i<num_layer;++i) {
-		LP_DP[i]=nullptr;
-		LP_cost.energy = energy_inf;
-		// std::cout << "\tStart " << network->getNode(i).name() << std::endl;
-		for(int j=-1;j<i;++j){
-			if(j != -1 && LP_DP[j] == nullptr) continue;
-			for(len_t l_bat=1;l_bat<=4&&l_bat<=tot_batch;l_bat*=2){
-				for(int last_T = has_S?0:1; last_T < (has_T?2:1); ++last_T){
-					if(j==i-1 && has_S && has_T && last_T > 0) break;
-					if(j==-1){
-						// Create top T-cut.
-						root_Node = new LTreeNode(Bitset(), tot_batch, nullptr, LTreeNode::NodeType::T);
-					}else {
-						// Use top T-cut from DP.
-						root_Node = LP_DP[j]->copy();
-						root_Node->reset_lset();
-					}
-					if(j == i-1){
-						// New LNode: last layer.
-						(void) new LTreeNode(i, tot_batch, root_Node);
-					}else{
-						LTreeNode* cur_Cut = new LTreeNode(Bitset(), tot_batch, root_Node, (last_T == 0) ? LTreeNode::NodeType::S : LTreeNode::NodeType::T);
-						for(int k=j+1;k<=i;++k){
-							(void) new LTreeNode(k, l_bat, cur_Cut);
-						}
-					}
-					root_Node->init_root();
-					// TODO: change to inc. search
-					tmp = SchNode::newNode(root_Node, c, nullptr);
-					if(!tmp->is_valid()){
-						delete tmp;
-						delete root_Node;
-						continue;
-					}
-					root_Node->confirm();
-					if(tmp->get_cost().cost() >= LP_cost.cost()){
-						delete tmp;
-						delete root_Node;
-						continue;
-					}
-					if(LP_DP[i]) delete LP_DP[i];
-					LP_DP[i] = root_Node;
-					LP_cost = tmp->get_cost();
-					if(last) delete last;
-					last = tmp;
-				}
-			}
-		}
-	}
-	tree_node = LP_DP[num_layer-1];
-	if(tree_node == nullptr){
-		std::cout << "Warning: no scheme found in LP_search!" << std::endl;
-		sch_res = nullptr;
-		if(last) delete last;
-	}else{
-		sch_res = last;
-	}
-	for(int i=0; i<num_layer-1; ++i) if(LP_DP[i]) delete LP_DP[i];
-	delete[] LP_DP;
-	return;
-}
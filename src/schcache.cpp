@@ -0,0 +1,108 @@
+#include "schcache.h"
+
+#include "cluster.h"
+#include "ltreenode.h"
+#include "schnode.h"
+
+
+SchCache::SchCache(std::size_t _capacity)
+	:capacity(_capacity), num_hit(0), num_miss(0){}
+
+SchCache::~SchCache(){
+	clear();
+}
+
+bool SchCache::add_subtree(key_t& key, LTreeNode* node, const Bitset& layers, const Cut* parent){
+	add_key(key, node->get_type());
+	add_key(key, node->get_tot_batch());
+
+	switch(node->get_type()){
+	case LTreeNode::NodeType::L:{
+		lid_t layerid = node->layers().first();
+		add_key(key, layerid);
+		add_key(key, node->get_to_dram());
+		add_key(key, static_cast<lid_t>(node->get_dirp_set().count()));
+		FOR_BITSET(prev, node->get_dirp_set()){
+			add_key(key, static_cast<lid_t>(prev));
+			if(layers.contains(prev)) continue;
+
+			// Direct prev outside the subtree, its ofmap layout is used in NoC.
+			const SchNode::nodeList_t& list = *static_cast<const SchNode*>(parent)->lnodeList;
+			auto it = list.find(prev);
+			if(it == list.end() || it->second == nullptr) return false;
+			const SchNode* from = it->second;
+			const PlaceSch& place = it->second->get_place_sch();
+			add_key(key, from->cluster.num_cores());
+			add_key(key, from->cluster[0].x);
+			add_key(key, from->cluster[0].y);
+			add_key(key, from->num_batch);
+			add_key(key, place.part.K);
+			add_key(key, place.part.B);
+			add_key(key, place.part.H);
+			add_key(key, place.part.W);
+			for(int i = 0; i < 4; ++i){
+				add_key(key, place.order[i]);
+			}
+		}
+		return true;
+	}
+	case LTreeNode::NodeType::S:
+		for(lid_t s : node->get_stages()){
+			add_key(key, s);
+		}
+		add_key(key, node->get_num_stage());
+		break;
+	case LTreeNode::NodeType::T:
+		break;
+	}
+
+	add_key(key, static_cast<lid_t>(node->get_children().size()));
+	for(auto child : node->get_children()){
+		if(!add_subtree(key, child, layers, parent)) return false;
+	}
+	return true;
+}
+
+bool SchCache::make_key(LTreeNode* node, const Cluster& c, const Cut* parent, key_t& key){
+	key.clear();
+	add_key(key, parent->is_DRAM_cut());
+	add_key(key, c.num_cores());
+	add_key(key, c[0].x);
+	add_key(key, c[0].y);
+	return add_subtree(key, node, node->layers(), parent);
+}
+
+const SchNode* SchCache::find(const key_t& key){
+	auto it = index.find(key);
+	if(it == index.end()){
+		++num_miss;
+		return nullptr;
+	}
+	++num_hit;
+	// Move to front.
+	entries.splice(entries.begin(), entries, it->second);
+	return it->second->second;
+}
+
+void SchCache::add(const key_t& key, const SchNode* sch){
+	if(capacity == 0 || index.count(key) > 0) return;
+	if(entries.size() >= capacity){
+		delete entries.back().second;
+		index.erase(entries.back().first);
+		entries.pop_back();
+	}
+	entries.emplace_front(key, sch->copy());
+	index[key] = entries.begin();
+}
+
+void SchCache::clear(){
+	for(auto& entry : entries){
+		delete entry.second;
+	}
+	entries.clear();
+	index.clear();
+}
+
+void SchCache::print_stats(std::ostream& os) const{
+	os << "Subtree cache: " << entries.size() << " entries, hit " << num_hit << '/' << num_hit + num_miss << std::endl;
+}
@@ -4,6 +4,7 @@
 
 #include "layerengine.h"
 #include "network.h"
+#include "schcache.h"
 #ifndef NOT_GEN_IR
 #include "json/json.h"
 #endif
@@ -13,6 +14,10 @@
 
 LayerEngine* SchNode::layerMapper=nullptr;
 len_t SchNode::tot_batch=0;
+thread_local const SchNode::nodeList_t* SchNode::reuseList=nullptr;
+thread_local SchCache* SchNode::subCache=nullptr;
+thread_local std::uint64_t SchNode::searchCount=0;
+thread_local LayerEngine* SchNode::threadMapper=nullptr;
 
 SchNode::sn_ptr SchNode::newNode(LTreeNode* _node, const Cluster& _c, Cut* parent){
 	switch (_node->get_type()) {
@@ -48,6 +53,90 @@ void SchNode::setParent(Cut* newParent){
 	}
 }
 
+void SchNode::setReuse(const SchNode* old){
+	reuseList = (old != nullptr) ? old->lnodeList : nullptr;
+}
+
+void SchNode::setCache(SchCache* cache){
+	subCache = cache;
+}
+
+std::uint64_t SchNode::getSearchCount(){
+	return searchCount;
+}
+
+void SchNode::setMapper(LayerEngine* mapper){
+	threadMapper = mapper;
+}
+
+bool SchNode::quick_check(LTreeNode* _node, const Cluster& _c){
+	vol_t wgt_vol;
+	return quick_check(_node, _c, true, false, wgt_vol);
+}
+
+bool SchNode::quick_check(LTreeNode* node, const Cluster& c, bool is_top, bool is_seg, vol_t& wgt_vol){
+	// Weights are kept on at most all cores of c.
+	const vol_t max_vol = layerMapper->get_ubuf_size() * c.num_cores();
+	wgt_vol = 0;
+
+	switch(node->get_type()){
+	case NodeType::L:{
+		// Weights from prev layers (or fmap weights) are counted as ifmap (see LNode::searchLayer).
+		const Node& layerT = network->getNode(node->layers().first());
+		const Layer& layer = layerT.layer();
+		if(layer.weight_size() == 0 || layerT.hasFmapWgt()) return true;
+
+		// Each part of weight is kept at least once (see StdLayerEngine::initLayouts).
+		fmap_range range(layer.ofmap_shape());
+		layer.ofm_to_wgt(range);
+		range.b = {0, 1};
+		wgt_vol = DIVCEIL(layer.get_sparsity().bits(range.size(), layer.get_wgt_bitwidth()), 8);
+		return wgt_vol <= max_vol;
+	}
+	case NodeType::S:{
+		// Allocate sub-clusters, same as SCut::construct.
+		const auto& cnodes = node->get_children();
+		cidx_t cnum = static_cast<cidx_t>(cnodes.size());
+		utime_t* tlist = new utime_t[cnum];
+		for(cidx_t i = 0; i < cnum; ++i){
+			tlist[i] = cnodes[i]->get_utime();
+		}
+		auto allocRes = c.try_alloc(tlist, cnum);
+		delete[] tlist;
+		if(!allocRes) return false;
+
+		for(cidx_t i = 0; i < cnum; ++i){
+			vol_t child_vol;
+			if(!quick_check(cnodes[i], c.sub_cluster(i, allocRes), false, false, child_vol)) return false;
+			wgt_vol += child_vol;
+		}
+		return wgt_vol <= max_vol;
+	}
+	case NodeType::T:{
+		// With weight shift, only weights of two adjacent children are kept (see TCut::construct).
+		bool wgt_shift = is_seg && (node->get_bgrp_num() == 1);
+		vol_t last_vol = 0;
+		bool is_first = true;
+		for(auto child : node->get_children()){
+			vol_t child_vol;
+			if(!quick_check(child, c, false, is_top, child_vol)) return false;
+			if(wgt_shift && !is_first && last_vol + child_vol > max_vol) return false;
+			wgt_vol += child_vol;
+			last_vol = child_vol;
+			is_first = false;
+		}
+		if(is_top) return true;
+		if(wgt_shift){
+			wgt_vol = 0;
+			return true;
+		}
+		return wgt_vol <= max_vol;
+	}
+	}
+	assert(false);
+	return false;
+}
+
 bool SchNode::is_valid() const{
 	return valid;
 }
@@ -141,19 +230,55 @@ std::ostream& operator<<(std::ostream& os, const SchNode* sch){
 
 /* #################### LNode #################### */
 
-bool LNode::search(){
-	auto res = layerMapper->search(this);
-
-	// If no valid scheme found, return
-	if(!res.isValid()) return false;
+const LNode* LNode::findReusable() const{
+	if(reuseList == nullptr) return nullptr;
+	auto it = reuseList->find(layerid);
+	if(it == reuseList->end() || it->second == nullptr) return nullptr;
+	const LNode* old = it->second;
+
+	if(!old->valid || old->num_batch != num_batch || old->cluster != cluster) return nullptr;
+	if(old->to_dram != to_dram || !(old->dirp_set == dirp_set)) return nullptr;
+
+	// Ofmap layouts of direct prevs, which are used in NoC.
+	FOR_BITSET(prev, dirp_set){
+		auto cur_it = lnodeList->find(prev);
+		auto old_it = reuseList->find(prev);
+		if(cur_it == lnodeList->end() || old_it == reuseList->end()) return nullptr;
+		const LNode* from = cur_it->second;
+		const LNode* old_from = old_it->second;
+		if(from == nullptr || old_from == nullptr) return nullptr;
+		if(from->num_batch != old_from->num_batch || from->cluster != old_from->cluster) return nullptr;
+		if(!(from->place_sch == old_from->place_sch)) return nullptr;
+	}
+	return old;
+}
 
-	// Otherwise, copy the returned scheme into this LNode
-	noc = std::move(res.noc);
-	ubuf_energy = res.extUbufEnergy;
-	place_sch = std::move(res.place);
-	tileSch = res.tileSch;
-	cost = res.totCost;
+bool LNode::search(){
+	// Same conditions give the same scheme, no need to search again.
+	const LNode* old = findReusable();
+	if(old != nullptr){
+		noc = old->noc;
+		ext_ubuf_energy = old->ext_ubuf_energy;
+		place_sch = PlaceSch(old->place_sch);
+		tileSch = old->tileSch;
+		search_cost = old->search_cost;
+	}else{
+		auto res = (threadMapper != nullptr ? threadMapper : layerMapper)->search(this);
+		++searchCount;
+
+		// If no valid scheme found, return
+		if(!res.isValid()) return false;
+
+		// Otherwise, copy the returned scheme into this LNode
+		noc = std::move(res.noc);
+		ext_ubuf_energy = res.extUbufEnergy;
+		place_sch = std::move(res.place);
+		tileSch = res.tileSch;
+		search_cost = res.totCost;
+	}
 
+	ubuf_energy = ext_ubuf_energy;
+	cost = search_cost;
 	return true;
 }
 
@@ -182,7 +307,7 @@ void LNode::searchLayer(){
 	}
 
 	// Update weight buffer usage
-	if(!place_sch.getWgtL().update(layert.hasWgtPrevs() ? ifm_usage : wgt_usage)){
+	if(!place_sch.getWgtL().update(layert.hasFmapWgt() ? ifm_usage : wgt_usage)){
 		valid = false;
 		return;
 	}
@@ -290,9 +415,9 @@ Cut::~Cut(){
  */
 SchNode::sn_ptr Cut::newNode(LTreeNode* _node, const Cluster& _c){
 	// When not in incremental search, construct new node directly.
-	if(curNode == nullptr) return SchNode::newNode(_node, _c, this);
+	if(curNode == nullptr) return buildNode(_node, _c);
 	// When new node is totally new, construct new node directly.
-	if(_node->isNew()) return SchNode::newNode(_node, _c, this);
+	if(_node->isNew()) return buildNode(_node, _c);
 
 	const Bitset& layers = _node->layers();
 	bool found = false, reSearch = false;
@@ -323,11 +448,29 @@ SchNode::sn_ptr Cut::newNode(LTreeNode* _node, const Cluster& _c){
 		}
 
 		delete node;
-		if(reSearch) return SchNode::newNode(_node, _c, this);
+		if(reSearch) return buildNode(_node, _c);
 	}
 
 	std::cerr << "[Warning] Cannot find old child in oldChildren." << std::endl;
-	return SchNode::newNode(_node, _c, this);
+	return buildNode(_node, _c);
+}
+
+SchNode::sn_ptr Cut::buildNode(LTreeNode* _node, const Cluster& _c){
+	// Single layers are handled by LNode::findReusable().
+	if(subCache == nullptr || _node->get_type() == NodeType::L){
+		return SchNode::newNode(_node, _c, this);
+	}
+
+	SchCache::key_t key;
+	if(!SchCache::make_key(_node, _c, this, key)){
+		return SchNode::newNode(_node, _c, this);
+	}
+	const SchNode* cached = subCache->find(key);
+	if(cached != nullptr) return cached->copy(this);
+
+	sn_ptr node = SchNode::newNode(_node, _c, this);
+	if(node->is_valid()) subCache->add(key, node);
+	return node;
 }
 
 void Cut::add(SchNode* child){
@@ -692,18 +835,37 @@ std::ostream& operator<<(std::ostream& os, const SchNode::SchCost& cost){
 
 // **************** Code for IR generation ****************
 
-SchNode::csn_ptr SchNode::root;
-SchNode::wlid_t SchNode::workload_cnt;
-SchNode::tfid_t SchNode::transferid_cnt;
-std::vector<std::vector<std::vector<SchNode::jsonindex_t> > > SchNode::wlid;
-std::vector<bool> SchNode::from_core, SchNode::weight_from_core, SchNode::to_dram;
-std::vector<std::map<fmap_range, SchNode::jsonindex_t> > SchNode::ofmapid;
-std::vector<std::set<Json::Value> > SchNode::curr_ifmap, SchNode::curr_weight;
-std::map<std::string,lid_t> SchNode::name_to_id;
-Json::Value SchNode::DRAM;
-std::map<Json::Value,SchNode::jsonindex_t> SchNode::DRAM_ofmap_pos;
-std::map<Json::Value,SchNode::jsonindex_t> SchNode::DRAM_weight_pos;
-std::map<SchNode::tfid_t,SchNode::jsonindex_t> SchNode::DRAM_ifmap_pos;
+// All states used during one IR generation.
+// Each call of IR_gen() owns its own context, so several IRs can be generated concurrently.
+struct SchNode::IRContext{
+	csn_ptr root;
+	wlid_t workload_cnt;
+	tfid_t transferid_cnt;
+	std::vector<Json::Value> workload_list;
+	std::vector<std::vector<std::vector<jsonindex_t> > > wlid;
+	std::vector<bool> from_core, weight_from_core, to_dram;
+	std::vector<std::map<fmap_range, jsonindex_t> > ofmapid;
+	std::vector<std::set<Json::Value> > curr_ifmap, curr_weight;
+	std::map<std::string,lid_t> name_to_id;
+	Json::Value DRAM;
+	std::map<Json::Value,jsonindex_t> DRAM_ofmap_pos;
+	std::map<Json::Value,jsonindex_t> DRAM_weight_pos;
+	std::map<tfid_t,jsonindex_t> DRAM_ifmap_pos;
+
+	IRContext(csn_ptr _root, cidx_t num_cores);
+
+	// Fills in the buffer information of all workloads on core "i".
+	void finalize_core(cidx_t i);
+};
+
+SchNode::IRContext::IRContext(csn_ptr _root, cidx_t num_cores)
+	:root(_root), workload_cnt(0), transferid_cnt(0), workload_list(num_cores),
+	 wlid(num_cores, std::vector<std::vector<jsonindex_t> >(network->len(), std::vector<jsonindex_t>(tot_batch))),
+	 curr_ifmap(num_cores), curr_weight(num_cores){
+	for(lid_t i=0; i<network->len(); ++i){
+		name_to_id[network->getNode(i).name()] = i;
+	}
+}
 
 const Cut* LNode::get_lca(const LNode* node1, const LNode* node2){
 	const Cut* lca = node2->parent;
@@ -714,138 +876,122 @@ const Cut* LNode::get_lca(const LNode* node1, const LNode* node2){
 }
 
 Json::Value SchNode::IR_gen() const{
-	std::vector<Json::Value> workload_list;
 	cidx_t num_cores = cluster.ylen * (cluster.xlen+2);
-	workload_list.resize(num_cores);
-	workload_cnt = 0;
-	transferid_cnt = 0;
-	root = this;
-	wlid.resize(num_cores);
-	for(size_t i=0;i<wlid.size();++i){
-		wlid[i].resize(network->len());
-		for(size_t j=0;j<wlid[i].size();++j){
-			wlid[i][j].resize(tot_batch);
-		}
-	}
-	ofmapid.resize(0);
-	from_core.resize(0);
-	weight_from_core.resize(0);
-	to_dram.resize(0);
-	curr_ifmap.resize(num_cores);
-	curr_weight.resize(num_cores);
-	name_to_id.clear();
-	DRAM.clear();
-	DRAM_ifmap_pos.clear();
-	DRAM_weight_pos.clear();
-	DRAM_ofmap_pos.clear();
-	for(int i=0; i<network->len(); ++i){
-		name_to_id[network->getNode(i).name()] = i;
-	}
-	add_workload_and_dfs(0, 0, workload_list);
+	IRContext ir(this, num_cores);
+	add_workload_and_dfs(0, 0, ir);
 
-	Json::Value ret;
 	for(cidx_t i=0;i<num_cores;++i){
-		for(const auto& ifmap:curr_ifmap[i]){
+		for(const auto& ifmap:ir.curr_ifmap[i]){
 			Json::StyledWriter swriter;
 			std::string IR_str = swriter.write(ifmap);
 			std::cout << IR_str;
 		}
-		for(const auto& weight:curr_weight[i]){
+		for(const auto& weight:ir.curr_weight[i]){
 			Json::StyledWriter swriter;
 			std::string IR_str = swriter.write(weight);
 			std::cout << IR_str;
 		}
-		assert(curr_ifmap[i].empty());
-		assert(curr_weight[i].empty());
-
-		Json::Value* last_wl = nullptr;
-		for(Json::Value& wl: workload_list[i]){
-			for(Json::Value& buffer: wl["buffer"]){
-				if(buffer["type"] == "ifmap"){
-					buffer["workload_id"] = workload_list[i][wlid[i][name_to_id[buffer["layer"].asString()]][buffer["lower"][0u].asUInt()]]["workload_id"];
-					buffer["source"] = workload_list[i][wlid[i][name_to_id[buffer["layer"].asString()]][buffer["lower"][(Json::Value::UInt) 0].asUInt()]]["ifmap_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][(Json::Value::UInt) 0].asUInt())]["source"];
-					for(Json::Value &source: buffer["source"]){
-						buffer["transfer_id"].append(source["transfer_id"]);
-					}
-				}
-				if(buffer["type"] == "weight"){
-					if(buffer.isMember("from_core")){
-						if(!buffer.isMember("workload_id")){
-							buffer["workload_id"] = workload_list[i][wlid[i][name_to_id[buffer["layer"].asString()]][buffer["lower"][0u].asUInt()]]["workload_id"];
-						}
-						buffer.removeMember("from_core");
-					}
-					if(!buffer.isMember("source")){
-						buffer["source"] = workload_list[i][wlid[i][name_to_id[buffer["layer"].asString()]][buffer["lower"][(Json::Value::UInt) 0].asUInt()]]["weight_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][(Json::Value::UInt) 0].asUInt())]["source"];
-					}
-					if(!buffer.isMember("transfer_id")){
-						for(Json::Value &source: buffer["source"]){
-							buffer["transfer_id"].append(source["transfer_id"]);
-						}
-					}
+		assert(ir.curr_ifmap[i].empty());
+		assert(ir.curr_weight[i].empty());
+	}
+
+	for(cidx_t i=0;i<num_cores;++i){
+		ir.finalize_core(i);
+	}
+
+	Json::Value ret;
+	for(cidx_t i=0;i<num_cores;++i){
+		if(ir.workload_list[i].type() != Json::nullValue){
+			ret[std::to_string(i)]=ir.workload_list[i];
+		}
+	}
+	for(auto &in: ir.DRAM["in"]){
+		if(in.isMember("related_ofmap_map")){
+			in.removeMember("related_ofmap_map");
+		}
+	}
+	ret["top_batch_cut"] = type != SchNode::NodeType::L ? dynamic_cast<const Cut*>(this)->get_num_bgrp() : 1;
+	ret["-1"] = ir.DRAM;
+	ret["xlen"] = cluster.xlen;
+	ret["ylen"] = cluster.ylen;
+	return ret;
+}
+
+void SchNode::IRContext::finalize_core(cidx_t i){
+	Json::Value* last_wl = nullptr;
+	for(Json::Value& wl: workload_list[i]){
+		for(Json::Value& buffer: wl["buffer"]){
+			if(buffer["type"] == "ifmap"){
+				buffer["workload_id"] = workload_list[i][wlid[i][name_to_id.at(buffer["layer"].asString())][buffer["lower"][0u].asUInt()]]["workload_id"];
+				buffer["source"] = workload_list[i][wlid[i][name_to_id.at(buffer["layer"].asString())][buffer["lower"][(Json::Value::UInt) 0].asUInt()]]["ifmap_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][(Json::Value::UInt) 0].asUInt())]["source"];
+				for(Json::Value &source: buffer["source"]){
+					buffer["transfer_id"].append(source["transfer_id"]);
 				}
 			}
-			if(wl.isMember("ifmap")){
-				if(!from_core[wl["workload_id"].asUInt()]){
-					Json::Value buffer;
-					buffer["type"] = "ifmap";
-					buffer["layer"] = wl["layer_name"];
-					buffer["lower"] = wl["ifmap"]["lower"];
-					buffer["upper"] = wl["ifmap"]["upper"];
-					buffer["workload_id"] = wl["workload_id"];
-					buffer["block"] = ((wl["ifmap"]["upper"][0u].asUInt() - wl["ifmap"]["lower"][0u].asUInt() + 1) * (wl["ifmap"]["upper"][1].asUInt() - wl["ifmap"]["lower"][1].asUInt() + 1) * (wl["ifmap"]["upper"][2].asUInt() - wl["ifmap"]["lower"][2].asUInt() + 1) * (wl["ifmap"]["upper"][3].asUInt() - wl["ifmap"]["lower"][3].asUInt() + 1) + 1023) >> 10;
-					buffer["source"] = wl["ifmap_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][0u].asUInt())]["source"];
-					for(Json::Value &source: buffer["source"]){
-						buffer["transfer_id"].append(source["transfer_id"]);
-					}
-					//buffer["DRAMIFMAP"] = true;
-					wl["buffer"].append(buffer);
-					if(last_wl && (*last_wl)["workload_id"] >= wl["ifmap"]["max_workload_id"].asUInt()){
-						(*last_wl)["buffer"].append(buffer);
+			if(buffer["type"] == "weight"){
+				if(buffer.isMember("from_core")){
+					if(!buffer.isMember("workload_id")){
+						buffer["workload_id"] = workload_list[i][wlid[i][name_to_id.at(buffer["layer"].asString())][buffer["lower"][0u].asUInt()]]["workload_id"];
 					}
+					buffer.removeMember("from_core");
 				}
-			}
-			if(wl.isMember("weight") && wl["weight"].isMember("from_ofmap")){
-				if(!weight_from_core[wl["workload_id"].asUInt()]){
-					Json::Value buffer;
-					buffer["type"] = "weight";
-					buffer["layer"] = wl["layer_name"];
-					buffer["lower"] = wl["weight"]["lower"];
-					buffer["upper"] = wl["weight"]["upper"];
-					buffer["workload_id"] = wl["workload_id"];
-					buffer["block"] = (wl["weight"]["size"].asUInt() / 8 + 1023) >> 10;
-					buffer["source"] = wl["weight_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][0u].asUInt())]["source"];
+				if(!buffer.isMember("source")){
+					buffer["source"] = workload_list[i][wlid[i][name_to_id.at(buffer["layer"].asString())][buffer["lower"][(Json::Value::UInt) 0].asUInt()]]["weight_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][(Json::Value::UInt) 0].asUInt())]["source"];
+				}
+				if(!buffer.isMember("transfer_id")){
 					for(Json::Value &source: buffer["source"]){
 						buffer["transfer_id"].append(source["transfer_id"]);
 					}
-					wl["buffer"].append(buffer);
-					if(last_wl && (*last_wl)["workload_id"] >= wl["weight"]["max_workload_id"].asUInt()){
-						(*last_wl)["buffer"].append(buffer);
-					}
 				}
 			}
-			if(wl.isMember("ifmap_temp")){
-				wl.removeMember("ifmap_temp");
+		}
+		if(wl.isMember("ifmap")){
+			if(!from_core[wl["workload_id"].asUInt()]){
+				Json::Value buffer;
+				buffer["type"] = "ifmap";
+				buffer["layer"] = wl["layer_name"];
+				buffer["lower"] = wl["ifmap"]["lower"];
+				buffer["upper"] = wl["ifmap"]["upper"];
+				buffer["workload_id"] = wl["workload_id"];
+				buffer["block"] = ((wl["ifmap"]["upper"][0u].asUInt() - wl["ifmap"]["lower"][0u].asUInt() + 1) * (wl["ifmap"]["upper"][1].asUInt() - wl["ifmap"]["lower"][1].asUInt() + 1) * (wl["ifmap"]["upper"][2].asUInt() - wl["ifmap"]["lower"][2].asUInt() + 1) * (wl["ifmap"]["upper"][3].asUInt() - wl["ifmap"]["lower"][3].asUInt() + 1) + 1023) >> 10;
+				buffer["source"] = wl["ifmap_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][0u].asUInt())]["source"];
+				for(Json::Value &source: buffer["source"]){
+					buffer["transfer_id"].append(source["transfer_id"]);
+				}
+				//buffer["DRAMIFMAP"] = true;
+				wl["buffer"].append(buffer);
+				if(last_wl && (*last_wl)["workload_id"] >= wl["ifmap"]["max_workload_id"].asUInt()){
+					(*last_wl)["buffer"].append(buffer);
+				}
 			}
-			if(wl.isMember("weight_temp")){
-				wl.removeMember("weight_temp");
+		}
+		if(wl.isMember("weight") && wl["weight"].isMember("from_ofmap")){
+			if(!weight_from_core[wl["workload_id"].asUInt()]){
+				Json::Value buffer;
+				buffer["type"] = "weight";
+				buffer["layer"] = wl["layer_name"];
+				buffer["lower"] = wl["weight"]["lower"];
+				buffer["upper"] = wl["weight"]["upper"];
+				buffer["workload_id"] = wl["workload_id"];
+				buffer["block"] = (wl["weight"]["size"].asUInt() / 8 + 1023) >> 10;
+				buffer["source"] = wl["weight_temp"][buffer["layer"].asString()+"_"+std::to_string(buffer["lower"][0u].asUInt())]["source"];
+				for(Json::Value &source: buffer["source"]){
+					buffer["transfer_id"].append(source["transfer_id"]);
+				}
+				wl["buffer"].append(buffer);
+				if(last_wl && (*last_wl)["workload_id"] >= wl["weight"]["max_workload_id"].asUInt()){
+					(*last_wl)["buffer"].append(buffer);
+				}
 			}
-			last_wl = &wl;
 		}
-		if(workload_list[i].type() != Json::nullValue){
-			ret[std::to_string(i)]=workload_list[i];
+		if(wl.isMember("ifmap_temp")){
+			wl.removeMember("ifmap_temp");
 		}
-	}
-	for(auto &in: DRAM["in"]){
-		if(in.isMember("related_ofmap_map")){
-			in.removeMember("related_ofmap_map");
+		if(wl.isMember("weight_temp")){
+			wl.removeMember("weight_temp");
 		}
+		last_wl = &wl;
 	}
-	ret["top_batch_cut"] = root->type != SchNode::NodeType::L ? dynamic_cast<const Cut*>(root)->get_num_bgrp() : 1;
-	ret["-1"] = DRAM;
-	ret["xlen"] = cluster.xlen;
-	ret["ylen"] = cluster.ylen;
-	return ret;
 }
 
 const LNode* LNode::get_lnode_by_id(lid_t id) const{
@@ -862,11 +1008,14 @@ const LNode* Cut::get_lnode_by_id(lid_t id) const{
 	return nullptr;
 }
 
-void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const{
+void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const{
 	//printf("layer: %s, batch: %d\n", layert.name().c_str(), batch_offset);
 	Json::Value empty_list;
 	empty_list.append(1);
 	empty_list.resize(0);
+	// Sizes are in bits (weights are compressed, see Sparsity).
+	const vol_t ofm_bits = layert.layer().get_bitwidth();
+	const vol_t wgt_bits = layert.layer().get_wgt_bitwidth();
 	const auto& ofm_parts = place_sch.getOfmL();
 	for(auto part: ofm_parts){
 		fmap_range range = part.first;
@@ -875,23 +1024,33 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 		pos_t core = part.second;
 		Cluster::xyid_t core_id = Cluster::get_xyid(core);
 		Json::Value workload;
-		workload["workload_id"] = workload_cnt++;
+		workload["workload_id"] = ir.workload_cnt++;
 		workload["layer_name"] = layert.name();
-		if(REF_IS_INSTANCE(layert.layer(), FCLayer)){
+		// Fused layers have the type of the base layer, with post layers in "fused".
+		const Layer& base_layer = layert.layer().base_layer();
+		if(REF_IS_INSTANCE(base_layer, FCLayer)){
 			workload["layer_type"] = "fc";
 		}
-		else if(REF_IS_INSTANCE(layert.layer(), ConvLayer)){
+		else if(REF_IS_INSTANCE(base_layer, MatMulLayer)){
+			workload["layer_type"] = "matmul";
+		}
+		else if(REF_IS_INSTANCE(base_layer, ConvLayer)){
 			workload["layer_type"] = "conv2d";
 		}
-		else if(REF_IS_INSTANCE(layert.layer(), PoolingLayer)){
+		else if(REF_IS_INSTANCE(base_layer, PoolingLayer)){
 			workload["layer_type"] = "pool";
 		}
-		else if(REF_IS_INSTANCE(layert.layer(), EltwiseLayer)){
+		else if(REF_IS_INSTANCE(base_layer, EltwiseLayer)){
 			workload["layer_type"] = "element_wise";
 		}
-		else if(REF_IS_INSTANCE(layert.layer(), PTPLayer)){
+		else if(REF_IS_INSTANCE(base_layer, PTPLayer)){
 			workload["layer_type"] = "point_to_point";
 		}
+		if(REF_IS_INSTANCE(layert.layer(), FusedLayer)){
+			for(const auto& post : static_cast<const FusedLayer&>(layert.layer()).get_posts()){
+				workload["fused"].append(REF_IS_INSTANCE(*post, PoolingLayer) ? "pool" : "point_to_point");
+			}
+		}
 		Json::Value oblock_lower, oblock_upper;
 		oblock_lower.append(range.b.from);
 		oblock_lower.append(range.c.from);
@@ -905,11 +1064,11 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 
 		workload["workload"].append(oblock_lower);
 		workload["workload"].append(oblock_upper);
-		workload["ofmap_size"] = range.size() * 8;
+		workload["ofmap_size"] = range.size() * ofm_bits;
 
 		workload["time"] = (int)tileSch.cost.time;
 
-		if(REF_IS_INSTANCE(layert.layer(), ConvLayer) && !layert.hasWgtPrevs()){
+		if(REF_IS_INSTANCE(layert.layer().base_layer(), ConvLayer) && !layert.hasFmapWgt()){
 			Json::Value weight;
 			weight["lower"] = range.c.from;
 			weight["upper"] = range.c.to - 1;
@@ -923,22 +1082,22 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			destination["id"] = core_id;
 			destination["workload_id"] = workload["workload_id"];
 			tfid_t transfer_id = 0;
-			if(DRAM_weight_pos.count(key)){
-				transfer_id = DRAM["out"][DRAM_weight_pos[key]]["transfer_id"].asUInt();
+			if(ir.DRAM_weight_pos.count(key)){
+				transfer_id = ir.DRAM["out"][ir.DRAM_weight_pos[key]]["transfer_id"].asUInt();
 				len_t batch_size = 0;
-				if(root->get_type() != NodeType::L){
-					batch_size = tot_batch/dynamic_cast<const Cut*>(root)->get_num_bgrp();
+				if(ir.root->get_type() != NodeType::L){
+					batch_size = tot_batch/dynamic_cast<const Cut*>(ir.root)->get_num_bgrp();
 				}
 				else{
 					batch_size = tot_batch;
 				}
 				if(batch_offset % batch_size == 0){
-					DRAM["out"][DRAM_weight_pos[key]]["destination"].append(destination);
+					ir.DRAM["out"][ir.DRAM_weight_pos[key]]["destination"].append(destination);
 				}
 			}
 			else{
-				DRAM_weight_pos[key] = DRAM["out"].size();
-				transfer_id = transferid_cnt++;
+				ir.DRAM_weight_pos[key] = ir.DRAM["out"].size();
+				transfer_id = ir.transferid_cnt++;
 				Json::Value dram_weight;
 				dram_weight["destination"].append(destination);
 				dram_weight["layer_name"] = layert.name();
@@ -946,10 +1105,10 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 				dram_weight["upper"] = weight["upper"];
 				dram_weight["related_ifmap"] = empty_list;
 				dram_weight["transfer_id"] = transfer_id;
-				ConvLayer::Workload wl = static_cast<const ConvLayer&>(layert.layer()).get_workload();
-				dram_weight["size"] = wl.R * wl.S * wl.C * range.c.size() * 8;
+				ConvLayer::Workload wl = static_cast<const ConvLayer&>(layert.layer().base_layer()).get_workload();
+				dram_weight["size"] = layert.layer().get_sparsity().bits(wl.R * wl.S * wl.C * range.c.size(), wgt_bits);
 				dram_weight["type"] = "weight";
-				DRAM["out"].append(dram_weight);
+				ir.DRAM["out"].append(dram_weight);
 			}
 			weight["transfer_id"].append(transfer_id);
 			workload["weight"] = weight;
@@ -960,7 +1119,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 		layert.layer().ofm_to_ifm(ofmap_range);
 		layert.layer().ofm_to_wgt(weight_range);
 
-		if(REF_IS_INSTANCE(layert.layer(), ConvLayer) && layert.hasWgtPrevs()){
+		if(REF_IS_INSTANCE(base_layer, ConvLayer) && layert.hasWgtPrevs()){
 			Json::Value weight;
 			weight["lower"].append(weight_range.b.from);
 			weight["lower"].append(weight_range.c.from);
@@ -969,7 +1128,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			weight["upper"].append(weight_range.c.to-1);
 			weight["upper"].append(weight_range.h.to-1);
 			weight["from_ofmap"] = true;
-			weight["size"] = weight_range.size() * 8;
+			weight["size"] = weight_range.size() * network->wgt_bitwidth(layerid);
 			workload["weight"] = weight;
 		}
 
@@ -989,12 +1148,16 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 		//std::cerr << prev;
 		bool from_other_core = false, weight_from_other_core = false;
 		len_t prev_channel_offset = 0;
+		// Weight rows of MatMul: external rows, then each weight prev (see Network::add).
+		const bool wgt_rows = REF_IS_INSTANCE(base_layer, MatMulLayer);
+		len_t prev_row_offset = layert.get_external_wgt_H();
 		FOR_BITSET(layerno, prev){
 			const Node& node = network->getNode(layerno);
-			const LNode* lnode = root->get_lnode_by_id(layerno);
+			const LNode* lnode = ir.root->get_lnode_by_id(layerno);
 			assert(layert.getIfmPrevs().contains(layerno)^layert.getWgtPrevs().contains(layerno));
 			const auto input_range = layert.getIfmPrevs().contains(layerno) ? ofmap_range : weight_range;
 			const auto real_prev_channel_offset = layert.getIfmPrevs().contains(layerno) ? prev_channel_offset : 0;
+			const len_t real_prev_row_offset = (wgt_rows && layert.getWgtPrevs().contains(layerno)) ? prev_row_offset : 0;
 			if(dirp_set.contains(layerno)){
 				for(auto prev_part: lnode->get_place_sch().getOfmL()){
 					for(len_t prev_batch_offset=0; prev_batch_offset<tot_batch; prev_batch_offset += lnode->num_batch){
@@ -1002,6 +1165,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 						fmap_range prev_range = prev_part.first;
 						prev_range.b += prev_batch_offset;
 						prev_range.c += real_prev_channel_offset;
+						prev_range.h += real_prev_row_offset;
 						/*if(layert.name() == "encoder1_QK" && !layert.getIfmPrevs().contains(layerno))
 						{
 							printf("prev_range_from = %d %d %d %d\n",prev_range.b.from,prev_range.c.from,prev_range.h.from,prev_range.w.from);
@@ -1015,6 +1179,8 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 							continue;
 						prev_range.c -= real_prev_channel_offset;
 						intersect.c -= real_prev_channel_offset;
+						prev_range.h -= real_prev_row_offset;
+						intersect.h -= real_prev_row_offset;
 						if(layert.getIfmPrevs().contains(layerno)){
 							from_other_core = 1;
 						}
@@ -1041,26 +1207,26 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 						}
 						ifmap["source"]["size"] = ifmap_size * 8;*/
 
-						ifmap["size"] = intersect.size()*8;
+						ifmap["size"] = intersect.size() * node.layer().get_bitwidth();
 
 						ifmap["type"] = "core";
 						ifmap["id"] = from_id;
-						//ifmap["workload_id"] = workload_list[from_id][wlid[from_id][layerno][intersect.b.from]]["workload_id"];
+						//ifmap["workload_id"] = ir.workload_list[from_id][ir.wlid[from_id][layerno][intersect.b.from]]["workload_id"];
 						ifmap["layer_name"] = node.name();
 
-						jsonindex_t prev_wlid = wlid[from_id][layerno][intersect.b.from];
-						wlid_t prev_workload_id = workload_list[from_id][prev_wlid]["workload_id"].asUInt();
+						jsonindex_t prev_wlid = ir.wlid[from_id][layerno][intersect.b.from];
+						wlid_t prev_workload_id = ir.workload_list[from_id][prev_wlid]["workload_id"].asUInt();
 						if(layert.getIfmPrevs().contains(layerno)){
 							max_from_workload_id = std::max(max_from_workload_id, prev_workload_id);
 						}
 						else{
 							weight_max_from_workload_id = std::max(weight_max_from_workload_id, prev_workload_id);
 						}
-						if(ofmapid[prev_workload_id].count(intersect)){
-							ifmap["transfer_id"] = workload_list[from_id][prev_wlid]["ofmap"][ofmapid[prev_workload_id][intersect]]["transfer_id"];
+						if(ir.ofmapid[prev_workload_id].count(intersect)){
+							ifmap["transfer_id"] = ir.workload_list[from_id][prev_wlid]["ofmap"][ir.ofmapid[prev_workload_id][intersect]]["transfer_id"];
 						}
 						else{
-							ifmap["transfer_id"] = transferid_cnt++;
+							ifmap["transfer_id"] = ir.transferid_cnt++;
 						}
 
 						if(layert.getIfmPrevs().contains(layerno)){
@@ -1079,8 +1245,8 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 						destination["workload_id"] = workload["workload_id"];
 						destination["layer_name"] = layert.name();
 
-						if(ofmapid[prev_workload_id].count(intersect)){
-							workload_list[from_id][prev_wlid]["ofmap"][ofmapid[prev_workload_id][intersect]]["destination"].append(destination);
+						if(ir.ofmapid[prev_workload_id].count(intersect)){
+							ir.workload_list[from_id][prev_wlid]["ofmap"][ir.ofmapid[prev_workload_id][intersect]]["destination"].append(destination);
 						}
 						else{
 							Json::Value ofmap;
@@ -1095,30 +1261,32 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 							ofmap["upper"].append(intersect.w.to-1);
 
 							ofmap["transfer_id"] = ifmap["transfer_id"];
-							ofmap["size"] = intersect.size()*8;
+							ofmap["size"] = intersect.size() * node.layer().get_bitwidth();
 
 							ofmap["destination"].append(destination);
-							ofmapid[prev_workload_id][intersect] = workload_list[from_id][prev_wlid]["ofmap"].size();
-							workload_list[from_id][prev_wlid]["ofmap"].append(ofmap);
+							ir.ofmapid[prev_workload_id][intersect] = ir.workload_list[from_id][prev_wlid]["ofmap"].size();
+							ir.workload_list[from_id][prev_wlid]["ofmap"].append(ofmap);
 						}
 					}
 				}
 			}
 			else{
-				int lower_c, upper_c;
+				int lower_c, upper_c, lower_h, upper_h;
 				lower_c = std::max(0, (int)input_range.c.from - (int)real_prev_channel_offset);
 				upper_c = std::min((int)node.layer().ofmap_shape().c, (int)input_range.c.to - (int)real_prev_channel_offset);
-				if(lower_c < upper_c){
+				lower_h = std::max(0, (int)input_range.h.from - (int)real_prev_row_offset);
+				upper_h = std::min((int)node.layer().ofmap_shape().h, (int)input_range.h.to - (int)real_prev_row_offset);
+				if(lower_c < upper_c && lower_h < upper_h){
 					Json::Value related_ifmap;
 					Json::Value ifmap;
 					ifmap["lower"].append(input_range.b.from);
 					ifmap["lower"].append(lower_c);
-					ifmap["lower"].append(input_range.h.from);
+					ifmap["lower"].append(lower_h);
 					ifmap["lower"].append(input_range.w.from);
 
 					ifmap["upper"].append(input_range.b.to-1);
 					ifmap["upper"].append(upper_c-1);
-					ifmap["upper"].append(input_range.h.to-1);
+					ifmap["upper"].append(upper_h-1);
 					ifmap["upper"].append(input_range.w.to-1);
 
 					ifmap["channel"].append(real_prev_channel_offset + lower_c);
@@ -1128,7 +1296,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 					for(int i=0; i<4; ++i){
 						ifmap_size *= ifmap["upper"][i].asUInt() - ifmap["lower"][i].asUInt() + 1;
 					}
-					ifmap["size"] = ifmap_size * 8;
+					ifmap["size"] = ifmap_size * node.layer().get_bitwidth();
 
 					ifmap["type"] = "DRAM";
 					ifmap["id"] = 0;
@@ -1143,11 +1311,11 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 
 					tfid_t ofmap_transfer_id;
 
-					if(DRAM_ofmap_pos.count(key)){
-						ofmap_transfer_id = DRAM["out"][DRAM_ofmap_pos[key]]["transfer_id"].asUInt();
+					if(ir.DRAM_ofmap_pos.count(key)){
+						ofmap_transfer_id = ir.DRAM["out"][ir.DRAM_ofmap_pos[key]]["transfer_id"].asUInt();
 					}
 					else{
-						ofmap_transfer_id = transferid_cnt++;
+						ofmap_transfer_id = ir.transferid_cnt++;
 					}
 
 					for(auto prev_part: lnode->get_place_sch().getOfmL()){
@@ -1156,6 +1324,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 							fmap_range prev_range = prev_part.first;
 							prev_range.b += prev_batch_offset;
 							prev_range.c += real_prev_channel_offset;
+							prev_range.h += real_prev_row_offset;
 							/*if(layert.name() == "encoder1_QK" && !layert.getIfmPrevs().contains(layerno))
 							{
 								printf("prev_range_from = %d %d %d %d\n",prev_range.b.from,prev_range.c.from,prev_range.h.from,prev_range.w.from);
@@ -1169,10 +1338,12 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 								continue;
 							prev_range.c -= real_prev_channel_offset;
 							intersect.c -= real_prev_channel_offset;
+							prev_range.h -= real_prev_row_offset;
+							intersect.h -= real_prev_row_offset;
 							tfid_t transfer_id;
 
-							jsonindex_t prev_wlid = wlid[from_id][layerno][intersect.b.from];
-							wlid_t prev_workload_id = workload_list[from_id][prev_wlid]["workload_id"].asUInt();
+							jsonindex_t prev_wlid = ir.wlid[from_id][layerno][intersect.b.from];
+							wlid_t prev_workload_id = ir.workload_list[from_id][prev_wlid]["workload_id"].asUInt();
 							if(layert.getIfmPrevs().contains(layerno)){
 								max_from_workload_id = std::max(max_from_workload_id, prev_workload_id);
 							}
@@ -1198,35 +1369,35 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 							source["core_id"] = from_id;
 							source["workload_id"] = prev_workload_id;
 
-							if(ofmapid[prev_workload_id].count(prev_range)){
-								transfer_id = workload_list[from_id][prev_wlid]["ofmap"][ofmapid[prev_workload_id][prev_range]]["transfer_id"].asUInt();
+							if(ir.ofmapid[prev_workload_id].count(prev_range)){
+								transfer_id = ir.workload_list[from_id][prev_wlid]["ofmap"][ir.ofmapid[prev_workload_id][prev_range]]["transfer_id"].asUInt();
 								source["transfer_id"] = transfer_id;
-								if(!SchNode::to_dram[prev_workload_id]){
-									workload_list[from_id][prev_wlid]["ofmap"][ofmapid[prev_workload_id][prev_range]]["destination"].append(destination);
-									SchNode::to_dram[prev_workload_id] = true;
-									DRAM_ifmap_pos[transfer_id] = DRAM["in"].size();
-									DRAM["in"].append(source);
+								if(!ir.to_dram[prev_workload_id]){
+									ir.workload_list[from_id][prev_wlid]["ofmap"][ir.ofmapid[prev_workload_id][prev_range]]["destination"].append(destination);
+									ir.to_dram[prev_workload_id] = true;
+									ir.DRAM_ifmap_pos[transfer_id] = ir.DRAM["in"].size();
+									ir.DRAM["in"].append(source);
 								}
 
 							}
 							else{
-								transfer_id = transferid_cnt++;
+								transfer_id = ir.transferid_cnt++;
 								source["transfer_id"] = transfer_id;
 								Json::Value ofmap;
 								ofmap["lower"] = source["lower"];
 								ofmap["upper"] = source["upper"];
 								ofmap["destination"].append(destination);
 								ofmap["transfer_id"] = transfer_id;
-								ofmap["size"] = prev_range.size() * 8;
-								SchNode::to_dram[workload_list[from_id][prev_wlid]["workload_id"].asUInt()] = true;
-								ofmapid[prev_workload_id][prev_range] = workload_list[from_id][prev_wlid]["ofmap"].size();
-								workload_list[from_id][prev_wlid]["ofmap"].append(ofmap);
-								DRAM_ifmap_pos[transfer_id] = DRAM["in"].size();
-								DRAM["in"].append(source);
+								ofmap["size"] = prev_range.size() * node.layer().get_bitwidth();
+								ir.to_dram[ir.workload_list[from_id][prev_wlid]["workload_id"].asUInt()] = true;
+								ir.ofmapid[prev_workload_id][prev_range] = ir.workload_list[from_id][prev_wlid]["ofmap"].size();
+								ir.workload_list[from_id][prev_wlid]["ofmap"].append(ofmap);
+								ir.DRAM_ifmap_pos[transfer_id] = ir.DRAM["in"].size();
+								ir.DRAM["in"].append(source);
 							}
-							if(!DRAM["in"][DRAM_ifmap_pos[transfer_id]]["related_ofmap_map"].isMember(std::to_string(ofmap_transfer_id))){
-								DRAM["in"][DRAM_ifmap_pos[transfer_id]]["related_ofmap"].append(ofmap_transfer_id);
-								DRAM["in"][DRAM_ifmap_pos[transfer_id]]["related_ofmap_map"][std::to_string(ofmap_transfer_id)] = true;
+							if(!ir.DRAM["in"][ir.DRAM_ifmap_pos[transfer_id]]["related_ofmap_map"].isMember(std::to_string(ofmap_transfer_id))){
+								ir.DRAM["in"][ir.DRAM_ifmap_pos[transfer_id]]["related_ofmap"].append(ofmap_transfer_id);
+								ir.DRAM["in"][ir.DRAM_ifmap_pos[transfer_id]]["related_ofmap_map"][std::to_string(ofmap_transfer_id)] = true;
 							}
 							related_ifmap.append(transfer_id);
 						}
@@ -1236,11 +1407,11 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 					destination["type"] = "core";
 					destination["workload_id"] = workload["workload_id"];
 
-					if(DRAM_ofmap_pos.count(key)){
-						DRAM["out"][DRAM_ofmap_pos[key]]["destination"].append(destination);
+					if(ir.DRAM_ofmap_pos.count(key)){
+						ir.DRAM["out"][ir.DRAM_ofmap_pos[key]]["destination"].append(destination);
 					}
 					else{
-						DRAM_ofmap_pos[key] = DRAM["out"].size();
+						ir.DRAM_ofmap_pos[key] = ir.DRAM["out"].size();
 						Json::Value ofmap;
 						ofmap["lower"] = key["lower"];
 						ofmap["upper"] = key["upper"];
@@ -1250,7 +1421,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 						ofmap["destination"].append(destination);
 						ofmap["related_ifmap"] = related_ifmap;
 						ofmap["type"] = "fmap";
-						DRAM["out"].append(ofmap);
+						ir.DRAM["out"].append(ofmap);
 					}
 					ifmap["transfer_id"] = ofmap_transfer_id;
 					if(layert.getIfmPrevs().contains(layerno)){
@@ -1266,6 +1437,8 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			}
 			if(layert.getIfmPrevs().contains(layerno)){
 				prev_channel_offset += network->getNode(layerno).layer().ofmap_shape().c;
+			}else if(wgt_rows){
+				prev_row_offset += network->getNode(layerno).layer().ofmap_shape().h;
 			}
 			//fprintf(stderr,"layerno = %d, add = %d\n", layerno, network->getNode(layerno).layer().ofmap_shape().c);
 			if(REF_IS_INSTANCE(layert.layer(), EltwiseLayer)){
@@ -1294,7 +1467,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 
 			ifmap["channel"].append(ofmap_range.c.from);
 			ifmap["channel"].append(ofmap_range.c.to-1);
-			ifmap["size"] = ofmap_range.size() * 8;
+			ifmap["size"] = ofmap_range.size() * ofm_bits;
 
 			ifmap["layer_name"] = "input";
 			ifmap["id"] = 0;
@@ -1307,11 +1480,11 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			key["upper"] = ifmap["upper"];
 
 			tfid_t transfer_id;
-			if(DRAM_ofmap_pos.count(key)){
-				transfer_id = DRAM["out"][DRAM_ofmap_pos[key]]["transfer_id"].asUInt();
+			if(ir.DRAM_ofmap_pos.count(key)){
+				transfer_id = ir.DRAM["out"][ir.DRAM_ofmap_pos[key]]["transfer_id"].asUInt();
 			}
 			else{
-				transfer_id = transferid_cnt++;
+				transfer_id = ir.transferid_cnt++;
 			}
 			ifmap["transfer_id"] = transfer_id;
 			workload["ifmap_temp"][layert.name()+"_"+std::to_string(range.b.from)]["source"].append(ifmap);
@@ -1320,11 +1493,11 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			destination["type"] = "core";
 			destination["workload_id"] = workload["workload_id"];
 
-			if(DRAM_ofmap_pos.count(key)){
-				DRAM["out"][DRAM_ofmap_pos[key]]["destination"].append(destination);
+			if(ir.DRAM_ofmap_pos.count(key)){
+				ir.DRAM["out"][ir.DRAM_ofmap_pos[key]]["destination"].append(destination);
 			}
 			else{
-				DRAM_ofmap_pos[key] = DRAM["out"].size();
+				ir.DRAM_ofmap_pos[key] = ir.DRAM["out"].size();
 				Json::Value input;
 				input["transfer_id"] = transfer_id;
 				input["layer_name"] = layert.name();
@@ -1334,7 +1507,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 				input["lower"] = ifmap["lower"];
 				input["upper"] = ifmap["upper"];
 				input["type"] = "fmap";
-				DRAM["out"].append(input);
+				ir.DRAM["out"].append(input);
 			}
 			workload["ifmap"]["transfer_id"].append(transfer_id);
 		}
@@ -1350,8 +1523,8 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			ofmap["upper"].append(range.h.to-1);
 			ofmap["upper"].append(range.w.to-1);
 
-			ofmap["size"] = range.size() * 8;
-			ofmap["transfer_id"] = transferid_cnt++;
+			ofmap["size"] = range.size() * ofm_bits;
+			ofmap["transfer_id"] = ir.transferid_cnt++;
 
 			Json::Value destination;
 			destination["type"] = "DRAM";
@@ -1368,14 +1541,14 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			output["workload_id"] = workload["workload_id"];
 			output["transfer_id"] = ofmap["transfer_id"];
 
-			DRAM["in"].append(output);
+			ir.DRAM["in"].append(output);
 		}
 
 		bool to_other_core = false;
 
 		FOR_BITSET(layerno, next){
 			const Node& node = network->getNode(layerno);
-			const LNode* lnode = root->get_lnode_by_id(layerno);
+			const LNode* lnode = ir.root->get_lnode_by_id(layerno);
 			len_t next_channel_offset = 0;
 			const Bitset& prev_set = node.getIfmPrevs();
 			if(lnode->layert.getIfmPrevs().contains(layerid)){
@@ -1392,6 +1565,15 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 				auto eltlayer = dynamic_cast<const EltwiseLayer*>(&(node.layer()));
 				next_channel_offset %= eltlayer->get_workload().K;
 			}
+			// Weight rows of MatMul (see Network::add).
+			len_t next_row_offset = 0;
+			if(REF_IS_INSTANCE(node.layer().base_layer(), MatMulLayer) && node.getWgtPrevs().contains(layerid)){
+				next_row_offset = node.get_external_wgt_H();
+				FOR_BITSET(lid, node.getWgtPrevs()){
+					if(lid == layerid) break;
+					next_row_offset += network->getNode(lid).layer().ofmap_shape().h;
+				}
+			}
 			if(lnode->get_dirp_set().contains(layerid)){
 				for(auto next_part: lnode->get_place_sch().getOfmL()){
 					for(len_t next_batch_offset=0; next_batch_offset<tot_batch; next_batch_offset += lnode->num_batch){
@@ -1406,8 +1588,10 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 							node.layer().ofm_to_wgt(next_range);
 						}
 						range.c += next_channel_offset;
+						range.h += next_row_offset;
 						fmap_range intersect = range.intersect(next_range);
 						range.c -= next_channel_offset;
+						range.h -= next_row_offset;
 						if(intersect.is_empty())
 							continue;
 						if(to_id != core_id){
@@ -1427,7 +1611,7 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 						buffer["upper"].append(next_range.h.to-1);
 						buffer["upper"].append(next_range.w.to-1);
 						buffer["block"] = ((next_range.size() + 1023) >> 10);
-						curr_ifmap[to_id].insert(buffer);
+						ir.curr_ifmap[to_id].insert(buffer);
 					}
 				}
 			}
@@ -1435,9 +1619,9 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 
 		len_t batch_size = 0;
 		Json::Value weight;
-		if(REF_IS_INSTANCE(layert.layer(), ConvLayer) && !layert.hasWgtPrevs()){
-			if(root->get_type() != NodeType::L){
-				batch_size = tot_batch/dynamic_cast<const Cut*>(root)->get_num_bgrp();
+		if(REF_IS_INSTANCE(layert.layer().base_layer(), ConvLayer) && !layert.hasFmapWgt()){
+			if(ir.root->get_type() != NodeType::L){
+				batch_size = tot_batch/dynamic_cast<const Cut*>(ir.root)->get_num_bgrp();
 			}
 			else{
 				batch_size = tot_batch;
@@ -1446,9 +1630,9 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			weight["layer"] = layert.name();
 			weight["lower"] = range.c.from;
 			weight["upper"] = range.c.to - 1;
-			ConvLayer::Workload wl = static_cast<const ConvLayer&>(layert.layer()).get_workload();
+			ConvLayer::Workload wl = static_cast<const ConvLayer&>(layert.layer().base_layer()).get_workload();
 			Json::Value source;
-			source["size"] = wl.R * wl.S * wl.C * range.c.size() * 8;
+			source["size"] = layert.layer().get_sparsity().bits(wl.R * wl.S * wl.C * range.c.size(), wgt_bits);
 			weight["block"] = (source["size"].asUInt() / 8 + 1023) >> 10;
 			source["id"] = 0;
 			source["type"] = "DRAM";
@@ -1458,19 +1642,19 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			weight["source"].append(source);
 			weight["transfer_id"].append(workload["weight"]["transfer_id"]);
 			if(batch_offset % batch_size == 0){
-				curr_weight[core_id].insert(weight);
-				if(workload_list[core_id].size() && get_lca(this, root->get_lnode_by_id(name_to_id[workload_list[core_id][workload_list[core_id].size()-1]["layer_name"].asString()])) != root){
-					if(workload_list[core_id][workload_list[core_id].size()-1]["layer_name"] != layert.name()){
-						workload_list[core_id][workload_list[core_id].size()-1]["buffer"].append(weight);
+				ir.curr_weight[core_id].insert(weight);
+				if(ir.workload_list[core_id].size() && get_lca(this, ir.root->get_lnode_by_id(ir.name_to_id[ir.workload_list[core_id][ir.workload_list[core_id].size()-1]["layer_name"].asString()])) != ir.root){
+					if(ir.workload_list[core_id][ir.workload_list[core_id].size()-1]["layer_name"] != layert.name()){
+						ir.workload_list[core_id][ir.workload_list[core_id].size()-1]["buffer"].append(weight);
 					}
 				}
 			}
 		}
 
-		for(const Json::Value& datablock : curr_ifmap[core_id]){
+		for(const Json::Value& datablock : ir.curr_ifmap[core_id]){
 			workload["buffer"].append(datablock);
 		}
-		for(const Json::Value& weight : curr_weight[core_id]){
+		for(const Json::Value& weight : ir.curr_weight[core_id]){
 			workload["buffer"].append(weight);
 		}
 		if(to_other_core || to_dram){
@@ -1487,60 +1671,60 @@ void LNode::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<
 			ofmap["upper"].append(range.w.to-1);
 			//ofmap["block"] = (range.size() + 10239) / 10240;
 			ofmap["block"] = 10;
-			ofmap["size"] = range.size() * 8;
+			ofmap["size"] = range.size() * ofm_bits;
 			workload["buffer"].append(ofmap);
 		}
 
 		for(len_t batch=range.b.from; batch<range.b.to; ++batch)
-			wlid[core_id][layerid][batch] = workload_list[core_id].size();
+			ir.wlid[core_id][layerid][batch] = ir.workload_list[core_id].size();
 
-		workload_list[core_id].append(workload);
+		ir.workload_list[core_id].append(workload);
 
 		std::vector<Json::Value> this_workload_ifmap;
-		for(const Json::Value& ifmap: curr_ifmap[core_id]){
+		for(const Json::Value& ifmap: ir.curr_ifmap[core_id]){
 			if(ifmap["layer"] == layert.name() && ifmap["lower"][0u] == range.b.from){
 				this_workload_ifmap.push_back(ifmap);
 			}
 		}
 		for(const Json::Value& ifmap: this_workload_ifmap){
-			curr_ifmap[core_id].erase(ifmap);
+			ir.curr_ifmap[core_id].erase(ifmap);
 		}
-		if(REF_IS_INSTANCE(layert.layer(), ConvLayer) && !layert.hasWgtPrevs()){
+		if(REF_IS_INSTANCE(layert.layer().base_layer(), ConvLayer) && !layert.hasFmapWgt()){
 			if((batch_offset + num_batch) % batch_size == 0){
-				for(auto weight : curr_weight[core_id]){
+				for(auto weight : ir.curr_weight[core_id]){
 					if(weight["layer"] == layert.name()){
-						curr_weight[core_id].erase(weight);
+						ir.curr_weight[core_id].erase(weight);
 						break;
 					}
 				}
 			}
 		}
-		ofmapid.resize(workload_cnt);
-		from_core.push_back(from_other_core);
-		weight_from_core.push_back(weight_from_other_core);
-		SchNode::to_dram.push_back(false);
+		ir.ofmapid.resize(ir.workload_cnt);
+		ir.from_core.push_back(from_other_core);
+		ir.weight_from_core.push_back(weight_from_other_core);
+		ir.to_dram.push_back(false);
 	}
 }
 
-void TCut::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const{
+void TCut::add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const{
 	for(len_t i=0;i<num_batch;i+=num_batch/num_bgrp){
 		for(auto& child : children){
-			child->add_workload_and_dfs(batch_offset + i, segment, workload_list);
-			if(this == root){
+			child->add_workload_and_dfs(batch_offset + i, segment, ir);
+			if(this == ir.root){
 				segment++;
 			}
 		}
 	}
 }
 
-void SCut::add_workload_and_dfs(len_t batch_offset, len_t segment, std::vector<Json::Value>& workload_list) const{
+void SCut::add_workload_and_dfs(len_t batch_offset, len_t segment, IRContext& ir) const{
 	const len_t stage_size = num_batch/num_bgrp;
 	for(len_t stage_id=0; stage_id < num_bgrp+num_stage; ++stage_id){
 		size_t i=0;
 		for(auto child : children){
 			if(stage_id >= stage[i] && stage_id < stage[i]+num_bgrp){
 				len_t stage_offset = (stage_id - stage[i]) * stage_size + batch_offset;
-				child->add_workload_and_dfs(stage_offset, segment, workload_list);
+				child->add_workload_and_dfs(stage_offset, segment, ir);
 			}
 			++i;
 		}
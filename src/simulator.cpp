@@ -0,0 +1,321 @@
+#include "simulator.h"
+
+#ifndef NOT_GEN_IR
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "noc.h"
+
+
+bool Simulator::Event::operator<(const Event& other) const{
+	if(time != other.time) return time > other.time;
+	return seq > other.seq;
+}
+
+Simulator::Simulator(const Json::Value& IR)
+	:xlen(static_cast<mlen_t>(IR["xlen"].asInt())), ylen(static_cast<mlen_t>(IR["ylen"].asInt())),
+	 link_free(4 * xlen * ylen, 0), link_busy(4 * xlen * ylen, 0), dram_free(0), dram_busy(0),
+	 event_cnt(0), cur_time(0), makespan(0), num_missing(0){
+	// IR id of a core is y * (xlen + 2) + x + 1, DRAM has id 0.
+	std::map<int, idx_t> core_map;
+	std::unordered_map<Json::UInt, idx_t> workload_map, transfer_map;
+
+	for(const std::string& name : IR.getMemberNames()){
+		if(name.empty() || !std::isdigit(name[0])) continue;
+		int id = std::stoi(name);
+		Core core;
+		core.pos.x = static_cast<mlen_t>(id % (xlen + 2) - 1);
+		core.pos.y = static_cast<mlen_t>(id / (xlen + 2));
+		core.next = 0;
+		core.busy = false;
+		core.busy_time = 0;
+		core_map[id] = cores.size();
+		cores.push_back(core);
+	}
+	const idx_t dram = cores.size();
+
+	// Workloads.
+	for(const auto& it : core_map){
+		for(const Json::Value& wl : IR[std::to_string(it.first)]){
+			Workload w;
+			w.core = it.second;
+			w.pos = cores[it.second].workloads.size();
+			w.time = wl["time"].asDouble();
+			w.pending_inputs = 0;
+			w.start = w.finish = 0;
+			workload_map[wl["workload_id"].asUInt()] = workloads.size();
+			cores[it.second].workloads.push_back(workloads.size());
+			workloads.push_back(w);
+		}
+	}
+
+	// Transfers.
+	auto new_transfer = [&](const Json::Value& data, idx_t src) -> idx_t{
+		idx_t t = transfers.size();
+		transfer_map[data["transfer_id"].asUInt()] = t;
+		Transfer tr;
+		tr.size = data["size"].asDouble() / 8;
+		tr.src = src;
+		tr.to_dram = false;
+		tr.src_ready = (src == dram);
+		tr.pending_writes = tr.pending_windows = 0;
+		tr.sent = false;
+		tr.finish = 0;
+		for(const Json::Value& dst : data["destination"]){
+			if(dst["type"] == "DRAM"){
+				tr.to_dram = true;
+				continue;
+			}
+			auto c = core_map.find(dst["id"].asInt());
+			auto w = workload_map.find(dst["workload_id"].asUInt());
+			if(c == core_map.end() || w == workload_map.end()){
+				++num_missing;
+				continue;
+			}
+			if(std::find(tr.dst_cores.begin(), tr.dst_cores.end(), c->second) == tr.dst_cores.end()){
+				tr.dst_cores.push_back(c->second);
+			}
+			if(std::find(tr.dst_workloads.begin(), tr.dst_workloads.end(), w->second) == tr.dst_workloads.end()){
+				tr.dst_workloads.push_back(w->second);
+				++workloads[w->second].pending_inputs;
+			}
+		}
+		transfers.push_back(std::move(tr));
+		return t;
+	};
+	for(const auto& it : core_map){
+		idx_t w = cores[it.second].workloads.empty() ? 0 : cores[it.second].workloads.front();
+		for(const Json::Value& wl : IR[std::to_string(it.first)]){
+			for(const Json::Value& ofmap : wl["ofmap"]){
+				workloads[w].outputs.push_back(new_transfer(ofmap, it.second));
+			}
+			++w;
+		}
+	}
+	const Json::Value& DRAM = IR["-1"];
+	for(const Json::Value& data : DRAM["out"]){
+		idx_t t = new_transfer(data, dram);
+		// Prefetch window: after the previous workload on each destination starts.
+		for(idx_t w : transfers[t].dst_workloads){
+			const Workload& dst = workloads[w];
+			if(dst.pos == 0) continue;
+			workloads[cores[dst.core].workloads[dst.pos - 1]].prefetches.push_back(t);
+			++transfers[t].pending_windows;
+		}
+	}
+	for(const Json::Value& data : DRAM["in"]){
+		auto it = transfer_map.find(data["transfer_id"].asUInt());
+		if(it == transfer_map.end()){
+			++num_missing;
+			continue;
+		}
+		for(const Json::Value& reader : data["related_ofmap"]){
+			auto r = transfer_map.find(reader.asUInt());
+			if(r == transfer_map.end()){
+				++num_missing;
+				continue;
+			}
+			transfers[it->second].readers.push_back(r->second);
+			++transfers[r->second].pending_writes;
+		}
+	}
+}
+
+std::size_t Simulator::link_idx(mlen_t x, mlen_t y, mlen_t dir) const{
+	return (static_cast<std::size_t>(x) * ylen + y) * 4 + dir;
+}
+
+void Simulator::mark_route(pos_t src, pos_t dst, std::vector<bool>& mark) const{
+	mlen_t x_dir = (dst.x > src.x)?0:2;
+	mlen_t y_dir = (dst.y > src.y)?3:1;
+	mlen_t dx = (dst.x > src.x)?1:-1;
+	mlen_t dy = (dst.y > src.y)?1:-1;
+	for(mlen_t x = src.x; x != dst.x; x += dx){
+		mark[link_idx(x, src.y, x_dir)] = true;
+	}
+	for(mlen_t y = src.y; y != dst.y; y += dy){
+		mark[link_idx(dst.x, y, y_dir)] = true;
+	}
+}
+
+void Simulator::push_event(stime_t time, EventType type, idx_t idx){
+	events.push({time, event_cnt++, type, idx});
+}
+
+void Simulator::try_start(idx_t c){
+	Core& core = cores[c];
+	if(core.busy || core.next >= core.workloads.size()) return;
+	Workload& w = workloads[core.workloads[core.next]];
+	if(w.pending_inputs > 0) return;
+
+	core.busy = true;
+	w.start = cur_time;
+	push_event(cur_time + w.time, EventType::WorkloadDone, core.workloads[core.next]);
+	for(idx_t t : w.prefetches){
+		--transfers[t].pending_windows;
+		try_send(t);
+	}
+}
+
+void Simulator::try_send(idx_t t){
+	Transfer& tr = transfers[t];
+	if(tr.sent || !tr.src_ready || tr.pending_writes > 0 || tr.pending_windows > 0) return;
+	tr.sent = true;
+
+	// Data volume on each link.
+	const idx_t dram = cores.size();
+	const std::size_t num_links = link_free.size();
+	std::vector<double> load(num_links, 0);
+	std::vector<bool> mark(num_links);
+	auto add_flow = [&](pos_t src, const std::vector<idx_t>& dsts, const pos_t* dram_port, double size){
+		std::fill(mark.begin(), mark.end(), false);
+		for(idx_t c : dsts){
+			mark_route(src, cores[c].pos, mark);
+		}
+		if(dram_port) mark_route(src, *dram_port, mark);
+		for(std::size_t l = 0; l < num_links; ++l){
+			if(mark[l]) load[l] += size;
+		}
+	};
+	const std::vector<pos_t>& ports = NoC::dram_list;
+	const double piece = tr.size / ports.size();
+	const bool use_dram = (tr.src == dram) || tr.to_dram;
+	if(tr.src == dram){
+		for(const pos_t& port : ports){
+			add_flow(port, tr.dst_cores, nullptr, piece);
+		}
+	}else{
+		add_flow(cores[tr.src].pos, tr.dst_cores, nullptr, tr.size);
+		if(tr.to_dram){
+			const std::vector<idx_t> no_cores;
+			for(const pos_t& port : ports){
+				add_flow(cores[tr.src].pos, no_cores, &port, piece);
+			}
+		}
+	}
+
+	// Reserves all links and DRAM from the earliest common free time.
+	stime_t start = cur_time;
+	for(std::size_t l = 0; l < num_links; ++l){
+		if(load[l] > 0) start = MAX(start, link_free[l]);
+	}
+	if(use_dram) start = MAX(start, dram_free);
+
+	stime_t finish = start;
+	for(std::size_t l = 0; l < num_links; ++l){
+		if(load[l] <= 0) continue;
+		stime_t busy = load[l] / NoC::NoC_bw;
+		link_free[l] = start + busy;
+		link_busy[l] += busy;
+		finish = MAX(finish, start + busy);
+	}
+	if(use_dram){
+		stime_t busy = tr.size / NoC::DRAM_bw;
+		dram_free = start + busy;
+		dram_busy += busy;
+		finish = MAX(finish, start + busy);
+	}
+	push_event(finish, EventType::TransferDone, t);
+}
+
+cycle_t Simulator::run(){
+	for(idx_t t = 0; t < transfers.size(); ++t){
+		try_send(t);
+	}
+	for(idx_t c = 0; c < cores.size(); ++c){
+		try_start(c);
+	}
+
+	while(!events.empty()){
+		Event e = events.top();
+		events.pop();
+		cur_time = e.time;
+		makespan = MAX(makespan, cur_time);
+
+		if(e.type == EventType::WorkloadDone){
+			Workload& w = workloads[e.idx];
+			Core& core = cores[w.core];
+			w.finish = cur_time;
+			core.busy = false;
+			core.busy_time += w.time;
+			++core.next;
+			for(idx_t t : w.outputs){
+				transfers[t].src_ready = true;
+				try_send(t);
+			}
+			try_start(w.core);
+		}else{
+			Transfer& tr = transfers[e.idx];
+			tr.finish = cur_time;
+			for(idx_t w : tr.dst_workloads){
+				if(--workloads[w].pending_inputs == 0) try_start(workloads[w].core);
+			}
+			for(idx_t r : tr.readers){
+				--transfers[r].pending_writes;
+				try_send(r);
+			}
+		}
+	}
+	return static_cast<cycle_t>(makespan + 0.5);
+}
+
+void Simulator::print_report(cycle_t predicted, std::ostream& os) const{
+	idx_t num_unfinished = 0;
+	for(const Core& core : cores){
+		num_unfinished += core.workloads.size() - core.next;
+	}
+	idx_t num_unsent = 0;
+	for(const Transfer& tr : transfers){
+		num_unsent += !tr.sent;
+	}
+
+	os << "Workloads: " << workloads.size() << ", Transfers: " << transfers.size() << std::endl;
+	if(num_missing > 0){
+		os << "[Warning] " << num_missing << " references to unknown transfers/workloads are ignored." << std::endl;
+	}
+	if(num_unfinished > 0 || num_unsent > 0){
+		os << "[Warning] Deadlock: " << num_unfinished << " workloads and " << num_unsent << " transfers are never started." << std::endl;
+	}
+
+	os << "Simulated: " << static_cast<cycle_t>(makespan + 0.5) << " cycles" << std::endl;
+	os << "Predicted: " << predicted << " cycles";
+	if(predicted > 0) os << " (simulated / predicted = " << makespan / predicted << ')';
+	os << std::endl;
+	if(makespan <= 0) return;
+
+	stime_t tot_busy = 0, max_busy = 0;
+	for(const Core& core : cores){
+		tot_busy += core.busy_time;
+		max_busy = MAX(max_busy, core.busy_time);
+	}
+	if(!cores.empty()){
+		os << "Core utilization: avg " << tot_busy * 100 / cores.size() / makespan << "%, max " << max_busy * 100 / makespan << '%' << std::endl;
+	}
+	os << "DRAM utilization: " << dram_busy * 100 / makespan << '%' << std::endl;
+
+	// Link from (x, y) to direction dir.
+	std::vector<std::size_t> used_links;
+	stime_t tot_link = 0;
+	for(std::size_t l = 0; l < link_busy.size(); ++l){
+		if(link_busy[l] <= 0) continue;
+		used_links.push_back(l);
+		tot_link += link_busy[l];
+	}
+	std::stable_sort(used_links.begin(), used_links.end(), [&](std::size_t a, std::size_t b){
+		return link_busy[a] > link_busy[b];
+	});
+	os << "NoC link utilization: avg " << tot_link * 100 / link_busy.size() / makespan << '%';
+	if(!used_links.empty()) os << ", max " << link_busy[used_links.front()] * 100 / makespan << '%';
+	os << std::endl;
+	static const char dir_name[] = "ESWN";
+	for(std::size_t l : used_links){
+		int x = static_cast<int>(l / 4 / ylen), y = static_cast<int>(l / 4 % ylen);
+		os << "\t(" << x << ',' << y << ")-" << dir_name[l % 4] << ": " << link_busy[l] * 100 / makespan << '%' << std::endl;
+	}
+}
+
+#endif // NOT_GEN_IR
@@ -0,0 +1,75 @@
+#include "transtable.h"
+
+#include <functional>
+
+#include "cluster.h"
+#include "ltreenode.h"
+
+
+std::size_t TransTable::fp_hash::operator()(const fp_t& fp) const{
+	return static_cast<std::size_t>(fp.first);
+}
+
+TransTable::TransTable(bool _shared, std::size_t _capacity)
+	:shared(_shared), capacity(_capacity){}
+
+void TransTable::add_tree(std::string& key, LTreeNode* node){
+	key.push_back(static_cast<char>(node->get_type()));
+	len_t num_batch = node->get_tot_batch();
+	key.append(reinterpret_cast<const char*>(&num_batch), sizeof(len_t));
+	if(node->get_type() == LTreeNode::NodeType::L){
+		lid_t layerid = node->layers().first();
+		key.append(reinterpret_cast<const char*>(&layerid), sizeof(lid_t));
+		return;
+	}
+
+	lid_t num_child = static_cast<lid_t>(node->get_children().size());
+	key.append(reinterpret_cast<const char*>(&num_child), sizeof(lid_t));
+	for(auto child : node->get_children()){
+		add_tree(key, child);
+	}
+}
+
+TransTable::fp_t TransTable::fingerprint(LTreeNode* root, const Cluster& c){
+	std::string key;
+	cidx_t num_cores = c.num_cores();
+	pos_t first = c[0];
+	key.append(reinterpret_cast<const char*>(&num_cores), sizeof(cidx_t));
+	key.push_back(static_cast<char>(first.x));
+	key.push_back(static_cast<char>(first.y));
+	add_tree(key, root);
+
+	// Two independent 64-bit hashes: FNV-1a and std::hash.
+	std::uint64_t h = 14695981039346656037ULL;
+	for(unsigned char ch : key){
+		h ^= ch;
+		h *= 1099511628211ULL;
+	}
+	return fp_t(h, std::hash<std::string>()(key));
+}
+
+bool TransTable::find(const fp_t& fp, Entry& entry){
+	std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
+	if(shared) lock.lock();
+
+	auto it = table.find(fp);
+	if(it == table.end()) return false;
+	entry = it->second;
+	return true;
+}
+
+void TransTable::add(const fp_t& fp, const Entry& entry){
+	std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
+	if(shared) lock.lock();
+
+	if(capacity == 0) return;
+	if(table.size() >= capacity) table.clear();
+	table.insert_or_assign(fp, entry);
+}
+
+void TransTable::clear(){
+	std::unique_lock<std::mutex> lock(mtx, std::defer_lock);
+	if(shared) lock.lock();
+
+	table.clear();
+}
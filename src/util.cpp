@@ -1,6 +1,7 @@
 #include "util.h"
 
 #include <cassert>
+#include <cmath>
 
 
 vol_t ofm_ubuf_vol;
@@ -211,3 +212,37 @@ fmap_range fmap_range::intersect(const fmap_range& other) const{
 std::ostream& operator<<(std::ostream& os, const fmap_range& range){
 	return os << "(B=" << range.b << ", C=" << range.c << ", H=" << range.h << ", W=" << range.w << ')';
 }
+
+
+/* ########## Sparsity ########## */
+
+Sparsity::Sparsity():N(1), M(1), density(1){}
+
+Sparsity::Sparsity(len_t _N, len_t _M, double _density)
+	:N(_N), M(_M), density(_density){
+	assert(0 < N && N <= M && 0 < density && density <= 1);
+}
+
+bool Sparsity::is_dense() const{
+	return N == M && density == 1;
+}
+
+double Sparsity::get_density() const{
+	return density * N / M;
+}
+
+vol_t Sparsity::bits(vol_t num, bwidth_t width) const{
+	if(is_dense()) return num * width;
+	vol_t nnz = num;
+	vol_t idx_bits = 0;
+	if(N < M){
+		nnz = MIN(DIVCEIL(num, M) * N, num);
+		while((static_cast<vol_t>(1) << idx_bits) < M) ++idx_bits;
+	}
+	nnz = static_cast<vol_t>(std::ceil(nnz * density));
+	return nnz * (width + idx_bits);
+}
+
+std::ostream& operator<<(std::ostream& os, const Sparsity& sp){
+	return os << sp.N << ':' << sp.M << '@' << sp.density;
+}